@@ -148,6 +148,9 @@ class QRCode {
 
     //Serial m_serial;
 
+    float m_base_direction; // heading from the last estimateBase() call
+    bool m_base_direction_found;
+
     public:
 
     float base_position_x;
@@ -155,6 +158,18 @@ class QRCode {
 
     vector<AprilTags::TagDetection> detections;
 
+    /**result of one estimateBase() call*/
+    struct BASE_ESTIMATE
+    {
+      bool position_found;
+      bool direction_found;
+      float x;         // base center relative to the uav, meter
+      float y;
+      float direction; // heading of the board in image, degree in (-180,180]
+      int tag_count;   // valid board tags in this frame
+      float quality;   // 0..1, visible tag ratio times heading agreement
+    };
+
     // default constructor
     QRCode();
     // changing the tag family
@@ -193,6 +208,10 @@ class QRCode {
 
     bool getBaseDirection(float& baseDirectionCita);
 
+    // position, direction, tag count and quality in one detection sweep
+    bool estimateBase(const cv::Mat& src, float detections_height,
+                      BASE_ESTIMATE& estimate);
+
 }; // Demo
 
 
@@ -8,6 +8,7 @@
 using namespace cv;
 
 #include <stdlib.h>
+#include <atomic>
 #include <cmath>
 #include <fstream>
 #include <iostream>
@@ -21,7 +22,9 @@ using namespace std;
 #include <ros/ros.h>
 #include <sensor_msgs/LaserScan.h>
 #include "AprilTags/QRCode.h"
+#include "rm_challenge_image_mailbox.h"
 #include "std_msgs/String.h"
+#include "test2/BaseResult.h"
 #define M100_CAMERA 1
 #define VIDEO_STREAM 2
 #define CURRENT_IMAGE_SOURCE VIDEO_STREAM
@@ -34,11 +37,10 @@ ros::Subscriber base_change_sub;
 image_transport::Subscriber vision_image_sub;
 
 QRCode qr_code;
-std::stringstream ss;
-cv::Mat g_image;
-bool g_is_new_image= false;
-bool g_is_base_running= true;
-float g_height= 2.4;
+/*written by the callbacks on the spinner thread, read by the main loop*/
+ImageMailbox g_mailbox;
+std::atomic<bool> g_is_base_running(true);
+std::atomic<float> g_height(2.4);
 
 void baseChangeCallback(const std_msgs::String::ConstPtr& msg);
 void guidance_distance_callback(const sensor_msgs::LaserScan& g_oa);
@@ -55,18 +57,18 @@ void guidance_distance_callback(const sensor_msgs::LaserScan& g_oa);
 
 void imageCallBack(const sensor_msgs::ImageConstPtr& msg)
 {
-  cv_bridge::CvImagePtr cv_ptr;
+  /*share the message data instead of copying it, the message is kept
+   * alive by the pointer in the mailbox*/
   try
   {
-    cv_ptr= cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::BGR8);
+    g_mailbox.post(
+        cv_bridge::toCvShare(msg, sensor_msgs::image_encodings::BGR8));
   }
   catch(cv_bridge::Exception& e)
   {
     ROS_ERROR("cv_bridge exception: %s", e.what());
     ROS_ERROR("Could not convert from '%s' to 'bgr8'.", msg->encoding.c_str());
   }
-  g_image= cv_ptr->image;
-  g_is_new_image= true;
 }
 
 int main(int argc, char** argv)
@@ -74,7 +76,7 @@ int main(int argc, char** argv)
   ros::init(argc, argv, "rm_challenge_qrcode_node");
   ros::NodeHandle node;
 
-  vision_base_pub= node.advertise<std_msgs::String>("tpp/base", 1);
+  vision_base_pub= node.advertise<test2::BaseResult>("tpp/base", 1);
 
   qr_code.setVisability(false);
   qr_code.setup();
@@ -90,50 +92,37 @@ int main(int argc, char** argv)
   // cv::cvtColor(m_copy, m_copy, CV_BGR2HSV);
   // cv::imshow("copy", m_copy);
   // cv::waitKey(1);
+  /*callbacks run on the spinner thread, the loop sleeps until they post
+   * a frame*/
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+  cv_bridge::CvImageConstPtr image_ptr;
   while(ros::ok())
   {
-    /*read available image*/
-    ros::spinOnce();
-
-    if(g_image.empty())
-      continue;
-
-    if(!g_is_new_image)
+    if(!g_mailbox.take(image_ptr, 1.0))
       continue;
 
     if(g_is_base_running)
     {
-      bool base_found;
-      float base_direction_degree= 0;
-      // ROS_INFO_STREAM("before");
-      if(qr_code.getBasePosition(g_image, g_height))
-      {
-        ROS_INFO_STREAM("base position :" << qr_code.getBaseX() << " "
-                                          << qr_code.getBaseY());
-        base_found= true;
-      }
+      QRCode::BASE_ESTIMATE base;
+      qr_code.estimateBase(image_ptr->image, g_height, base);
+      if(base.position_found)
+        ROS_INFO_STREAM("base position :" << base.x << " " << base.y);
       else
-      {
         ROS_INFO_STREAM("can't find base");
-        ROS_INFO_STREAM("base position :" << qr_code.getBaseX() << " "
-                                          << qr_code.getBaseY());
-        base_found= false;
-      }
-      // ROS_INFO_STREAM("after");
-      qr_code.getBaseDirection(base_direction_degree);
-      ROS_INFO_STREAM("base direction:" << base_direction_degree);
-
-      ss.str("");
-      std_msgs::String base_msg;
-      ss << base_found << " " << qr_code.getBaseX() << " " << qr_code.getBaseY()
-         << " " << base_direction_degree;
-      base_msg.data= ss.str();
+      ROS_INFO_STREAM("base direction:" << base.direction << " tags:"
+                                        << base.tag_count
+                                        << " quality:" << base.quality);
+
+      /*stamp of the frame the estimate comes from*/
+      test2::BaseResultPtr base_msg(new test2::BaseResult);
+      base_msg->header.stamp= image_ptr->header.stamp;
+      base_msg->position_found= base.position_found;
+      base_msg->x= base.x;
+      base_msg->y= base.y;
+      base_msg->direction= base.direction;
       vision_base_pub.publish(base_msg);
-
-      g_is_new_image= false;
     }
-
-    cv::waitKey(1);
   }
 
   return 1;
@@ -0,0 +1,132 @@
+#include "AprilTags/QRCode.h"
+#include "rm_challenge_image_mailbox.h"
+
+#include <image_transport/image_transport.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <sensor_msgs/LaserScan.h>
+#include "std_msgs/String.h"
+#include "test2/BaseResult.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace rm_challenge
+{
+/**
+ * rm_challenge_qrcode_node as a nodelet. Loaded into the camera's
+ * manager, it gets the frames of m100/image by pointer and publishes the
+ * base estimate on tpp/base, like rm_challenge_qrcode_node.
+ */
+class QRCodeNodelet : public nodelet::Nodelet
+{
+public:
+  QRCodeNodelet() : m_is_base_running(true), m_height(2.4), m_running(false)
+  {
+  }
+
+  ~QRCodeNodelet()
+  {
+    m_running= false;
+    if(m_thread.joinable())
+      m_thread.join();
+  }
+
+private:
+  virtual void onInit()
+  {
+    ros::NodeHandle& node= getNodeHandle();
+
+    m_qr_code.setVisability(false);
+    m_qr_code.setup();
+
+    m_base_pub= node.advertise<test2::BaseResult>("tpp/base", 1);
+    m_base_change_sub= node.subscribe(
+        "/tpp/base_change", 1, &QRCodeNodelet::baseChangeCallback, this);
+    m_distance_sub=
+        node.subscribe("/guidance/obstacle_distance", 1,
+                       &QRCodeNodelet::guidanceDistanceCallback, this);
+    m_image_transport.reset(new image_transport::ImageTransport(node));
+    m_image_sub= m_image_transport->subscribe(
+        "m100/image", 1, &QRCodeNodelet::imageCallback, this);
+
+    /*the tags are detected on our own thread, the callbacks only post*/
+    m_running= true;
+    m_thread= std::thread(&QRCodeNodelet::processLoop, this);
+  }
+
+  void baseChangeCallback(const std_msgs::String::ConstPtr& msg)
+  {
+    NODELET_INFO_STREAM("receive base change info");
+    if(msg->data == "pause")
+      m_is_base_running= false;
+    else if(msg->data == "resume")
+      m_is_base_running= true;
+    else
+      NODELET_INFO_STREAM("invalid state");
+  }
+
+  void guidanceDistanceCallback(const sensor_msgs::LaserScan& g_oa)
+  {
+    m_height= g_oa.ranges[0];
+  }
+
+  void imageCallback(const sensor_msgs::ImageConstPtr& msg)
+  {
+    /*share the message data instead of copying it*/
+    try
+    {
+      m_mailbox.post(
+          cv_bridge::toCvShare(msg, sensor_msgs::image_encodings::BGR8));
+    }
+    catch(cv_bridge::Exception& e)
+    {
+      NODELET_ERROR("cv_bridge exception: %s", e.what());
+    }
+  }
+
+  void processLoop()
+  {
+    cv_bridge::CvImageConstPtr image_ptr;
+    while(m_running && ros::ok())
+    {
+      if(!m_mailbox.take(image_ptr, 1.0))
+        continue;
+      if(!m_is_base_running)
+        continue;
+
+      QRCode::BASE_ESTIMATE base;
+      m_qr_code.estimateBase(image_ptr->image, m_height, base);
+      NODELET_INFO_STREAM_THROTTLE(
+          1.0, "base found: " << base.position_found << " tags: "
+                              << base.tag_count
+                              << " quality: " << base.quality);
+
+      /*stamp of the frame the estimate comes from*/
+      test2::BaseResultPtr base_msg(new test2::BaseResult);
+      base_msg->header.stamp= image_ptr->header.stamp;
+      base_msg->position_found= base.position_found;
+      base_msg->x= base.x;
+      base_msg->y= base.y;
+      base_msg->direction= base.direction;
+      m_base_pub.publish(base_msg);
+    }
+  }
+
+  QRCode m_qr_code;
+  ros::Publisher m_base_pub;
+  ros::Subscriber m_base_change_sub;
+  ros::Subscriber m_distance_sub;
+  /*outlives the subscriber that posts to it*/
+  ImageMailbox m_mailbox;
+  std::unique_ptr<image_transport::ImageTransport> m_image_transport;
+  image_transport::Subscriber m_image_sub;
+  std::atomic<bool> m_is_base_running;
+  std::atomic<float> m_height;
+  std::thread m_thread;
+  std::atomic<bool> m_running;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(rm_challenge::QRCodeNodelet, nodelet::Nodelet)
@@ -97,6 +97,25 @@ bool reduceErrorByExtraCircle(cv::Point circlePoint, float radius,
       distance_to_correct / move_vector_length * (y4 - centerPoint_y);
   return true;
 }
+/**
+ * Layout of the base board, indexed by tag id, in meter relative to the
+ * board center. Ids 7, 8 and 9 are not on the board.
+ */
+static const int BASE_TAG_NUMBER= 8;
+static const cv::Point2f BASE_TAG_LOCATION[11]= {
+  cv::Point2f(-0.85, 0.85), cv::Point2f(-0.85, 0.00), cv::Point2f(-0.85, -0.85),
+  cv::Point2f(0.00, 0.85),  cv::Point2f(0.00, -0.85), cv::Point2f(0.85, 0.85),
+  cv::Point2f(0.85, 0.00),  cv::Point2f(0.00, 0.00),  cv::Point2f(0.00, 0.00),
+  cv::Point2f(0.00, 0.00),  cv::Point2f(0.85, -0.85)
+};
+
+static bool isBaseTag(const AprilTags::TagDetection& detection)
+{
+  if(detection.hammingDistance != 0)
+    return false;
+  return (detection.id >= 0 && detection.id <= 6) || detection.id == 10;
+}
+
 // default constructor
 QRCode::QRCode()
   :  // default settings, most can be modified through command line
@@ -129,6 +148,8 @@ QRCode::QRCode()
 
   base_position_x(0.0)
   , base_position_y(0.0)
+  , m_base_direction(0.0)
+  , m_base_direction_found(false)
 {
 }
 
@@ -357,39 +378,17 @@ void QRCode::getDetectionLocationAndDistance(
     vector<cv::Point2f>& detections_location,
     vector<float>& detections_distance, float detections_height)
 {
-  /*static cv::Point2f id2location[12]= {
-    cv::Point2f(-0.85, -0.85),   cv::Point2f(0.0, -0.85),  cv::Point2f(0.85, -0.85),
-    cv::Point2f(-0.85, 0.0),  cv::Point2f(0.85, 0.0), cv::Point2f(-0.85, 0.85),
-    cv::Point2f(0.0, 0.85), cv::Point2f(0.0, 0.0),   cv::Point2f(0.0, 0.0),
-    cv::Point2f(0.0, 0.0),   cv::Point2f(0.85, 0.85)
-  };*/
-  static cv::Point2f id2location[12]= {
-    cv::Point2f(-0.85, 0.85),   cv::Point2f(-0.85, 0.00),  cv::Point2f(-0.85, -0.85),
-    cv::Point2f(0.00, 0.85),  cv::Point2f(0.00, -0.85), cv::Point2f(0.85, 0.85),
-    cv::Point2f(0.85, 0.00), cv::Point2f(0.00, 0.00),   cv::Point2f(0.00, 0.00),
-    cv::Point2f(0.00, 0.00),   cv::Point2f(0.85, -0.85)
-  };
-
   for(int i= 0; i < detections.size(); i++)
   {
-    if(detections[i].hammingDistance != 0)
-      continue;
-    if(!((detections[i].id >= 0 && detections[i].id <= 6) ||
-          detections[i].id == 10))
+    if(!isBaseTag(detections[i]))
       continue;
-    detections_location.push_back(id2location[detections[i].id]);
+    detections_location.push_back(BASE_TAG_LOCATION[detections[i].id]);
 
     Eigen::Vector3d translation;
     Eigen::Matrix3d rotation;
     detections[i].getRelativeTranslationRotation(m_tagSize, m_fx, m_fy, m_px,
                                                  m_py, translation, rotation);
 
-    Eigen::Matrix3d F;
-    F << 1, 0, 0, 0, -1, 0, 0, 0, 1;
-    Eigen::Matrix3d fixed_rot= F * rotation;
-    double yaw, pitch, roll;
-    wRo_to_euler(fixed_rot, yaw, pitch, roll);
-
     float ground_distance=
         sqrt(abs(pow(translation.norm(), 2) - pow(detections_height, 2)));
     detections_distance.push_back(ground_distance);
@@ -661,18 +660,8 @@ ros::Time::now(), "camera_rgb_optical_frame", "marker_frame"));
 
 bool QRCode::getBasePosition(const cv::Mat& src, float detections_height)
 {
-  cv::Mat image_gray;
-  vector<cv::Point2f> detections_location;
-  vector<float> detections_distance;
-
-  detections.clear();
-  processImage(src, image_gray);
-  if(detections.size()==0)
-    return false;
-  getDetectionLocationAndDistance(detections_location, detections_distance,
-                                 detections_height);
-  return calculateBasePostion(detections_location, detections_distance);
-  
+  BASE_ESTIMATE estimate;
+  return estimateBase(src, detections_height, estimate);
 }
 
 float QRCode::getBaseX()
@@ -690,69 +679,103 @@ void QRCode::setVisability(bool visable)
   m_draw= visable;
 }
 
+/**
+ * heading computed by the last getBasePosition()/estimateBase() call,
+ * no second pass over the detections
+ */
 bool QRCode::getBaseDirection(float& baseDirectionCita)
 {
-  if( detections.size() <= 2)
+  baseDirectionCita= m_base_direction;
+  return m_base_direction_found;
+}
+
+/**
+ * Detect tags once and derive everything the base task needs from that
+ * single sweep: board location, ground distance and image center of every
+ * valid tag are collected together, then the position is trilaterated and
+ * the heading is the circular mean of the board-to-image angle over all tag
+ * pairs. The board frame used for the heading is the position frame
+ * rotated by 90 degree, i.e. (y, -x).
+ * quality = (visible tags / board tags) * (mean resultant length of the
+ * pairwise headings), a single tag counts as half agreement.
+ */
+bool QRCode::estimateBase(const cv::Mat& src, float detections_height,
+                          BASE_ESTIMATE& estimate)
+{
+  cv::Mat image_gray;
+  vector<cv::Point2f> detections_location;
+  vector<float> detections_distance;
+  vector<cv::Point2f> detections_center;
+
+  estimate.position_found= false;
+  estimate.direction_found= false;
+  estimate.direction= 0.0;
+  estimate.tag_count= 0;
+  estimate.quality= 0.0;
+
+  detections.clear();
+  processImage(src, image_gray);
+
+  for(int i= 0; i < detections.size(); i++)
   {
-    baseDirectionCita = 0.0;
-    return false;
+    if(!isBaseTag(detections[i]))
+      continue;
+    detections_location.push_back(BASE_TAG_LOCATION[detections[i].id]);
+    detections_center.push_back(
+        cv::Point2f(detections[i].cxy.first, detections[i].cxy.second));
+
+    Eigen::Vector3d translation;
+    Eigen::Matrix3d rotation;
+    detections[i].getRelativeTranslationRotation(m_tagSize, m_fx, m_fy, m_px,
+                                                 m_py, translation, rotation);
+    float ground_distance=
+        sqrt(abs(pow(translation.norm(), 2) - pow(detections_height, 2)));
+    detections_distance.push_back(ground_distance);
   }
-  /*static cv::Point2f id2location[12]= {
-    cv::Point2f(0.2, 1.9),   cv::Point2f(0.2, 1.05),  cv::Point2f(0.2, 0.2),
-    cv::Point2f(1.05, 1.9),  cv::Point2f(1.05, 0.2), cv::Point2f(1.90, 1.9),
-    cv::Point2f(1.9, 1.05), cv::Point2f(0.0, 0.0),   cv::Point2f(0.0, 0.0),
-    cv::Point2f(0.0, 0.0),   cv::Point2f(1.9, 0.2)
-  };*/
-  static cv::Point2f id2location[12]= {
-    cv::Point2f(1.9, 1.9),   cv::Point2f(1.05, 1.9),  cv::Point2f(0.2, 1.9),
-    cv::Point2f(1.9, 1.05),  cv::Point2f(0.2, 1.05), cv::Point2f(1.90, 0.2),
-    cv::Point2f(1.05, 0.2), cv::Point2f(0.0, 0.0),   cv::Point2f(0.0, 0.0),
-    cv::Point2f(0.0, 0.0),   cv::Point2f(0.2, 0.2)
-  };
-  float base_vector_x, base_vector_y, base_alpha,
-        img_vector_x, img_vector_y, img_beta;
-  float degree;
-  vector< float > degrees;
-  float degree_sum = 0;
-  for( int i=0; i<detections.size()-1; i++)
+  int tag_cnt= detections_location.size();
+  estimate.tag_count= tag_cnt;
+
+  /*position*/
+  estimate.position_found=
+      calculateBasePostion(detections_location, detections_distance);
+  estimate.x= base_position_x;
+  estimate.y= base_position_y;
+
+  /*direction, sum unit vectors so that -179 and 179 average to 180*/
+  float sin_sum= 0, cos_sum= 0;
+  int pair_cnt= 0;
+  for(int i= 0; i < tag_cnt - 1; i++)
   {
-    if(detections[i].hammingDistance != 0)
-      continue;
-    if(!((detections[i].id >= 0 && detections[i].id <= 6) ||
-          detections[i].id == 10))
-      continue;    
-    for(int j=i+1; j<detections.size(); j++)
+    for(int j= i + 1; j < tag_cnt; j++)
     {
-      if(detections[j].hammingDistance != 0 ||
-          !( (detections[j].id>=0 &&
-              detections[j].id<=6) ||
-            detections[j].id==10) )
-        continue;
-
-      base_vector_x = id2location[detections[j].id].x
-        - id2location[detections[i].id].x;
-      base_vector_y = id2location[detections[j].id].y
-        - id2location[detections[i].id].y;
-      img_vector_x = detections[j].cxy.first 
-        - detections[i].cxy.first;
-      img_vector_y = detections[j].cxy.second 
-        - detections[i].cxy.second;
-      base_alpha = atan2(base_vector_x, base_vector_y)*180/PI;
-      img_beta = atan2(img_vector_x, img_vector_y)*180/PI;
-      degree = img_beta - base_alpha;
-      degrees.push_back(degree);
+      float base_vector_x=
+          detections_location[j].y - detections_location[i].y;
+      float base_vector_y=
+          detections_location[i].x - detections_location[j].x;
+      float img_vector_x= detections_center[j].x - detections_center[i].x;
+      float img_vector_y= detections_center[j].y - detections_center[i].y;
+      float cita= atan2(img_vector_x, img_vector_y) -
+                  atan2(base_vector_x, base_vector_y);
+      sin_sum+= sin(cita);
+      cos_sum+= cos(cita);
+      pair_cnt++;
     }
   }
-  if(degrees.size()==0)
+  float agreement= tag_cnt == 1 ? 0.5 : 0.0;
+  if(pair_cnt > 0)
   {
-  	baseDirectionCita = 0.0;
-  	return false;
+    agreement= sqrt(sin_sum * sin_sum + cos_sum * cos_sum) / pair_cnt;
+    /*keep the old rule: heading needs more than two tags*/
+    if(tag_cnt > 2)
+    {
+      estimate.direction= atan2(sin_sum, cos_sum) * 180 / PI;
+      estimate.direction_found= true;
+    }
   }
-  for(int i=0; i<degrees.size(); i++)
-  {
+  float visible= (float)tag_cnt / BASE_TAG_NUMBER;
+  estimate.quality= (visible > 1 ? 1 : visible) * agreement;
 
-    degree_sum += degrees[i];
-  }
-  baseDirectionCita = degree_sum / degrees.size();
-  return true;
+  m_base_direction= estimate.direction;
+  m_base_direction_found= estimate.direction_found;
+  return estimate.position_found;
 }
@@ -0,0 +1,160 @@
+// base armor detector
+#include "FindArmorV.h"
+#include "rm_challenge_event_log.h"
+#include "rm_challenge_image_mailbox.h"
+
+#include <image_transport/image_transport.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/file_log.h>
+#include "std_msgs/String.h"
+#include "test2/BomberResult.h"
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+
+/*read by FindBase, set once from rb_param*/
+bool we_color;
+
+namespace rm_challenge
+{
+/**
+ * bomber_node as a nodelet. Loaded into the camera's manager, it gets
+ * the frames of m100/image by pointer and publishes the move toward the
+ * base on tpp/bomber, like bomber_node.
+ * Parameters (private):
+ *   rb_param: our color, "r" or "b"
+ *   event_log: file of the moves, read by rm_event_log_decode. When
+ *     another nodelet of the manager opened a log first, it is used
+ */
+class BomberNodelet : public nodelet::Nodelet
+{
+public:
+  BomberNodelet() : m_is_running(true), m_running(false)
+  {
+  }
+
+  ~BomberNodelet()
+  {
+    m_running= false;
+    if(m_thread.joinable())
+      m_thread.join();
+  }
+
+private:
+  virtual void onInit()
+  {
+    ros::NodeHandle& node= getNodeHandle();
+    ros::NodeHandle& private_node= getPrivateNodeHandle();
+
+    std::string color;
+    private_node.param<std::string>("rb_param", color, "");
+    if(color == "r")
+      we_color= WE_RED;
+    else if(color == "b")
+      we_color= WE_BLUE;
+    else
+    {
+      NODELET_ERROR_STREAM("not a valid color!");
+      return;
+    }
+
+    std::string event_file;
+    private_node.param<std::string>(
+        "event_log", event_file,
+        ros::file_log::getLogDirectory() + "/bomber_events.bin");
+    if(!g_event_log.isOpened() && !g_event_log.open(event_file))
+      NODELET_WARN_STREAM("can't open event log " << event_file);
+
+    m_bomber_pub= node.advertise<test2::BomberResult>("tpp/bomber", 1);
+    m_running_sub= node.subscribe("/tpp/base_task", 1,
+                                  &BomberNodelet::runningCallback, this);
+    m_image_transport.reset(new image_transport::ImageTransport(node));
+    m_image_sub= m_image_transport->subscribe(
+        "/m100/image", 1, &BomberNodelet::imageCallback, this);
+
+    /*FindBase runs on our own thread, the callbacks only post*/
+    m_running= true;
+    m_thread= std::thread(&BomberNodelet::processLoop, this);
+  }
+
+  void runningCallback(const std_msgs::String::ConstPtr& msg)
+  {
+    NODELET_INFO_STREAM("receive bomber running info");
+    if(msg->data == "close")
+      m_is_running= false;
+    else if(msg->data == "open")
+      m_is_running= true;
+    else
+      NODELET_INFO_STREAM("invalid state");
+  }
+
+  void imageCallback(const sensor_msgs::ImageConstPtr& msg)
+  {
+    /*share the message data instead of copying it*/
+    try
+    {
+      m_mailbox.post(
+          cv_bridge::toCvShare(msg, sensor_msgs::image_encodings::BGR8));
+    }
+    catch(cv_bridge::Exception& e)
+    {
+      NODELET_ERROR("cv_bridge exception: %s", e.what());
+    }
+  }
+
+  void processLoop()
+  {
+    cv_bridge::CvImageConstPtr image_ptr;
+    while(m_running && ros::ok())
+    {
+      if(!m_mailbox.take(image_ptr, 1.0))
+        continue;
+      if(!m_is_running)
+        continue;
+      /*FindBase draws on the image, the shared frame must stay
+       * untouched*/
+      cv::Mat image= image_ptr->image.clone();
+      bool base_found= false;
+      Point base_center(0, 0);
+      FindBase(image, base_found, base_center);
+
+      float move_x_msg= 0, move_y_msg= 0;
+      bool bomb_signal= false;
+      if(base_found)
+      {
+        float move_x= 240 - base_center.y;
+        float move_y= -320 + base_center.x;
+        move_x_msg= move_x / 500.0;
+        move_y_msg= move_y / 500.0;
+        bomb_signal= sqrt(move_x * move_x + move_y * move_y) < 40;
+      }
+
+      /*stamp of the frame the command comes from*/
+      test2::BomberResultPtr bomber_msg(new test2::BomberResult);
+      bomber_msg->header.stamp= image_ptr->header.stamp;
+      bomber_msg->vx= move_x_msg;
+      bomber_msg->vy= move_y_msg;
+      bomber_msg->can_bomb= bomb_signal;
+      bomber_msg->base_found= base_found;
+      m_bomber_pub.publish(bomber_msg);
+      g_event_log.log(EV_BOMBER_MOVE, bomb_signal, move_x_msg, move_y_msg,
+                      base_found);
+    }
+  }
+
+  ros::Publisher m_bomber_pub;
+  ros::Subscriber m_running_sub;
+  /*outlives the subscriber that posts to it*/
+  ImageMailbox m_mailbox;
+  std::unique_ptr<image_transport::ImageTransport> m_image_transport;
+  image_transport::Subscriber m_image_sub;
+  std::atomic<bool> m_is_running;
+  std::thread m_thread;
+  std::atomic<bool> m_running;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(rm_challenge::BomberNodelet, nodelet::Nodelet)
@@ -22,6 +22,7 @@ using namespace std;
 //#include <string>
 #include <vector>
 #include <list>
+#include <atomic>
 #include <sys/time.h>
 
 // OpenCV library for easy access to USB camera and drawing of images
@@ -34,12 +35,17 @@ using namespace std;
 
 // base armor detector
 #include "FindArmorV.h"
+#include "rm_challenge_video_recorder.h"
+#include "rm_challenge_event_log.h"
+#include "rm_challenge_image_mailbox.h"
 
 //ros
 #include <ros/ros.h>
 #include "std_msgs/String.h"
+#include "test2/BomberResult.h"
 #include <cv_bridge/cv_bridge.h>
 #include <image_transport/image_transport.h>
+#include <ros/file_log.h>
 
 // utility function to provide current system time (used below in
 // determining frame rate at which images are being processed)
@@ -68,9 +74,11 @@ ros::Subscriber bomber_running_sub;
 image_transport::Subscriber vision_image_sub;
 
 std::stringstream ss;
-cv::Mat g_image;
-bool g_is_new_image= false;
-bool g_is_bomber_running= true;
+/*written by the callbacks on the spinner thread, read by the loop*/
+ImageMailbox g_mailbox;
+std::atomic<bool> g_is_bomber_running(true);
+/*frame the loop works on*/
+cv_bridge::CvImageConstPtr g_image_ptr;
 
 void bomberRunningCallback(const std_msgs::String::ConstPtr& msg)
 {
@@ -85,18 +93,18 @@ void bomberRunningCallback(const std_msgs::String::ConstPtr& msg)
 
 void imageCallBack(const sensor_msgs::ImageConstPtr& msg)
 {
-  cv_bridge::CvImagePtr cv_ptr;
+  /*share the message data instead of copying it, the message is kept
+   * alive by the pointer in the mailbox*/
   try
   {
-    cv_ptr= cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::BGR8);
+    g_mailbox.post(
+        cv_bridge::toCvShare(msg, sensor_msgs::image_encodings::BGR8));
   }
   catch(cv_bridge::Exception& e)
   {
     ROS_ERROR("cv_bridge exception: %s", e.what());
     ROS_ERROR("Could not convert from '%s' to 'bgr8'.", msg->encoding.c_str());
   }
-  g_image= cv_ptr->image;
-  g_is_new_image= true;
 }
 
 
@@ -396,11 +404,8 @@ class Demo
                 move_y = (-320 + BaseCenter.x);
                 move_x_msg = move_x/500.0;
                 move_y_msg = move_y/500.0;
-                cout << "move_x:"<<move_x_msg<<endl;
-                cout << "move_y:"<<move_y_msg<<endl;
                 if(sqrt(move_x*move_x+move_y*move_y)<40)
                         {
-                            cout<<"Base STOP!!!BOMB!!"<<endl;
                             bomb_signal = 1;
                         }
 
@@ -459,14 +464,16 @@ class Demo
             //imshow("apriltags_demo", image); // OpenCV call
         }
 
-    std_msgs::String bomber_msg;
-    std::stringstream ss;
-    ss << move_x_msg << " "
-       << move_y_msg << " "
-       << bomb_signal << " "
-       << BaseFound;
-    bomber_msg.data= ss.str();
+    /*stamp of the frame the command comes from*/
+    test2::BomberResultPtr bomber_msg(new test2::BomberResult);
+    bomber_msg->header.stamp= g_image_ptr->header.stamp;
+    bomber_msg->vx= move_x_msg;
+    bomber_msg->vy= move_y_msg;
+    bomber_msg->can_bomb= bomb_signal;
+    bomber_msg->base_found= BaseFound;
     bomber_pub.publish(bomber_msg);
+    g_event_log.log(EV_BOMBER_MOVE, bomb_signal, move_x_msg, move_y_msg,
+                    BaseFound);
 
 
     }
@@ -482,7 +489,8 @@ class Demo
         int frame = 0;
         double last_t = tic();
 
-		cv::VideoWriter g_writer;
+		/*encodes on its own thread, frames are dropped when it falls behind*/
+		VideoRecorder g_writer;
 
         for(int a=0;a<base_position_length;a++)
         {
@@ -510,15 +518,15 @@ class Demo
 		}
 
 
+		/*callbacks run on the spinner thread, the loop sleeps until they
+		 * post a frame*/
+		ros::AsyncSpinner spinner(1);
+		spinner.start();
         while (ros::ok())
         {
- 			cv::waitKey(1);
-            ros::spinOnce();
-			if(!g_is_bomber_running)
-				continue;
-			if(g_image.empty())
+			if(!g_mailbox.take(g_image_ptr, 1.0))
 				continue;
-			if(!g_is_new_image)
+			if(!g_is_bomber_running)
 				continue;
             /*if(g_image.empty()||!g_is_new_image||!g_is_bomber_running)
 			{
@@ -528,7 +536,9 @@ class Demo
 
             // capture frame
             // m_cap >> image;
-            image=g_image.clone();
+            /*FindBase draws on the image, the shared frame must stay
+             * untouched*/
+            image=g_image_ptr->image.clone();
 
             processImage(image, image_gray);
 
@@ -543,21 +553,16 @@ class Demo
 
 
 
-            g_is_new_image= false;
             // exit if any key is pressed
             // if (cv::waitKey(1) >= 0)            break;
             //cv::waitKey(1);
-			ROS_INFO("base running ");
-			if(we_color==WE_BLUE)//blue
-				ROS_INFO_STREAM("bomber we color is BLUE");
-			if(we_color==WE_RED)//blue
-				ROS_INFO_STREAM("bomber we color is RED");
 			if(want_record_video=='y')
 			{
-				g_writer.write(g_image);
+				g_writer.write(g_image_ptr->image);
 			}
         }
-		g_writer.release();
+		g_writer.close();
+		g_event_log.close();
     }
 
 }; // Demo
@@ -567,9 +572,16 @@ int main(int argc, char *argv[])
 {
     ros::init(argc, argv, "bomber_node");
     ros::NodeHandle node;
+    /*per frame moves go to the event log, decoded by rm_event_log_decode*/
+    ros::NodeHandle private_node("~");
+    string event_file;
+    private_node.param<string>("event_log", event_file,
+        ros::file_log::getLogDirectory() + "/bomber_events.bin");
+    if(!g_event_log.open(event_file))
+        ROS_WARN_STREAM("can't open event log " << event_file);
 
 
-    bomber_pub = node.advertise<std_msgs::String>("tpp/bomber", 1);
+    bomber_pub = node.advertise<test2::BomberResult>("tpp/bomber", 1);
     image_transport::ImageTransport image_transport(node);
     vision_image_sub=
       image_transport.subscribe("/m100/image", 1, imageCallBack);
@@ -71,6 +71,9 @@ const string intro = "\n"
 #include "AprilTags/Tag36h9.h"
 #include "AprilTags/Tag36h11.h"
 
+// derived images shared with the other detectors of the camera node
+#include "rm_challenge_frame_context.h"
+
 
 // Needed for getopt / command line options processing
 #include <unistd.h>
@@ -178,6 +181,8 @@ class QRCode {
 
     void processImage(cv::Mat& image, cv::Mat& image_gray,
                       vector<AprilTags::TagDetection>& detections);
+    void processGrayImage(cv::Mat& image, const cv::Mat& image_gray,
+                          vector<AprilTags::TagDetection>& detections);
     // Load and process a single image
     //void loadImages();
     // Video or image processing?
@@ -188,6 +193,7 @@ class QRCode {
     //void loop(int argc, char* argv[]);
 
     bool getBasePosition(cv::Mat& src, float detections_height);
+    bool getBasePosition(FrameContext& frame, float detections_height);
 
     float getBaseX();
     float getBaseY();
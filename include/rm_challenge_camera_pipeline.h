@@ -0,0 +1,66 @@
+#ifndef RM_CHALLENGE_CAMERA_PIPELINE_H
+#define RM_CHALLENGE_CAMERA_PIPELINE_H
+
+#include "rm_challenge_vision.h"
+#include "rm_challenge_executor.h"
+#include "rm_challenge_image_publisher.h"
+#include "rm_challenge_latency_tracer.h"
+
+#include <atomic>
+#include "test2/BaseResult.h"
+#include "test2/LineResult.h"
+#include "test2/PillarResult.h"
+
+/**
+ * Work done on every camera frame: the frame is published as a shared
+ * pointer when m100/image has subscribers, so consumers in the same
+ * nodelet manager get it without serialization or another copy. Pillar
+ * and line detectors then run in parallel on the frame and their
+ * results are published. Used by rm_challenge_camera_node and by the
+ * camera nodelet.
+ */
+class CameraPipeline
+{
+public:
+  /**topics are on node, their parameters on config_node*/
+  CameraPipeline(ros::NodeHandle& node, ros::NodeHandle& config_node,
+                 RMChallengeVision::COLOR_TYPE color, bool visable);
+
+  /**publish frame and the detector results of it, stamp is the time
+   * the frame was captured. frame is only read*/
+  void process(const cv::Mat& frame, const ros::Time& stamp);
+
+  void colorChangeCallback(const std_msgs::String::ConstPtr& msg);
+  void pillarChangeCallback(const std_msgs::String::ConstPtr& msg);
+  void lineChangeCallback(const std_msgs::String::ConstPtr& msg);
+
+private:
+  void publishPillar(const ros::Time& stamp,
+                     RMChallengeVision::COLOR_TYPE color,
+                     RMChallengeVision::PILLAR_RESULT& pillar_result);
+  void publishLine(const ros::Time& stamp, bool is_T_found, float distance_x,
+                   float distance_y, float line_vector_x, float line_vector_y);
+
+  ros::Publisher m_pillar_pub;
+  ros::Publisher m_line_pub;
+  ros::Publisher m_base_pub;
+  ImagePublisher m_image_pub;
+  ros::Subscriber m_color_change_sub;
+  ros::Subscriber m_pillar_change_sub;
+  ros::Subscriber m_line_change_sub;
+
+  /**changed by callbacks, which may run on other threads in a nodelet*/
+  atomic<int> m_color;
+  atomic<bool> m_is_pillar_running;
+  atomic<bool> m_is_line_running;
+
+  /**one vision instance per detector task*/
+  RMChallengeVision m_pillar_vision;
+  RMChallengeVision m_line_vision;
+  DetectorExecutor m_executor;
+  FrameContext m_frame_context;
+  /**age of the frames at every stage, published on tpp/latency/camera*/
+  LatencyTracer m_latency;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef RM_CHALLENGE_EVENT_LOG_H
+#define RM_CHALLENGE_EVENT_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/**
+ * Binary log for the events of the control and vision loops. log() fills
+ * one fixed size record in a ring owned by the calling thread, without
+ * locking, formatting or system calls, and drops the record when the
+ * ring is full. A flushing thread writes the rings to the file
+ * periodically. The file is read back with rm_event_log_decode.
+ *
+ * Nothing is recorded until open() is called, so the programs that do not
+ * keep a log only pay one atomic load per event.
+ */
+
+/**events, append only: the decoder of older logs relies on the ids*/
+enum EVENT_ID
+{
+  EV_LOG_DROPPED,
+  EV_FSM_TICK,
+  EV_UAV_STATE,
+  EV_GUIDANCE_HEIGHT,
+  EV_GUIDANCE_POSITION,
+  EV_CAMERA_FRAME,
+  EV_PILLAR_STAGE,
+  EV_PILLAR_CIRCLE,
+  EV_PILLAR_RESULT,
+  EV_LINE_RESULT,
+  EV_BOMBER_MOVE,
+  EV_FSM_STATE,
+  EV_COUNT
+};
+
+/**one event, 32 bytes*/
+struct EVENT_RECORD
+{
+  uint64_t stamp_ns; // system clock, same axis as ros::Time
+  uint16_t id;
+  uint16_t thread;   // order the thread logged its first event in
+  int32_t value;
+  float data[4];
+};
+
+/**name of the event and of its fields, NULL fields are not used*/
+struct EVENT_INFO
+{
+  const char* name;
+  const char* value_name;
+  const char* data_name[4];
+};
+
+/**file header, followed by the records*/
+struct EVENT_FILE_HEADER
+{
+  char magic[4]; // "RMEV"
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t reserved;
+};
+
+class EventLog
+{
+public:
+  /**ring_size records per thread, rounded up to a power of two*/
+  EventLog(int ring_size= 4096, double flush_period= 0.1);
+  ~EventLog();
+
+  /**create file and start the flushing thread*/
+  bool open(const string& file_name);
+  /**write what is left in the rings, then close the file*/
+  void close();
+  bool isOpened() const;
+
+  void log(EVENT_ID id, int value= 0, float d0= 0, float d1= 0,
+           float d2= 0, float d3= 0);
+
+  static const EVENT_INFO& info(int id);
+
+private:
+  struct RING
+  {
+    vector<EVENT_RECORD> records;
+    /*written by the logging thread only*/
+    atomic<uint32_t> head;
+    /*written by the flushing thread only*/
+    atomic<uint32_t> tail;
+    atomic<uint32_t> dropped;
+    uint32_t reported_dropped;
+    uint16_t thread;
+  };
+
+  RING* threadRing();
+  void flushLoop();
+  void flushRing(RING& ring);
+
+  uint32_t m_ring_size;
+  double m_flush_period;
+  atomic<bool> m_open;
+  FILE* m_file;
+
+  /*rings live until the log is destroyed, threads keep pointers to them*/
+  vector<unique_ptr<RING> > m_rings;
+  mutex m_rings_mutex;
+
+  bool m_stop;
+  thread m_thread;
+  mutex m_mutex;
+  condition_variable m_cv;
+};
+
+/**the log of the process, opened by the node's main*/
+extern EventLog g_event_log;
+
+#endif
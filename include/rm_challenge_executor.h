@@ -0,0 +1,72 @@
+#ifndef RM_CHALLENGE_EXECUTOR_H
+#define RM_CHALLENGE_EXECUTOR_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/**
+ * Runs the detectors of one frame on a fixed pool of threads.
+ * Tasks are added for each frame, a task starts once all tasks it comes
+ * after are done, run() returns when every task is done. The time each
+ * task took is kept so the critical path of a frame can be reported.
+ * add and run are called from one thread only.
+ */
+class DetectorExecutor
+{
+public:
+  struct TASK_TIMING
+  {
+    string name;
+    double last_ms;    // time of the last run
+    double average_ms; // moving average
+  };
+
+  DetectorExecutor(int thread_num);
+  ~DetectorExecutor();
+
+  /**drop the tasks of the last frame, timings are kept*/
+  void clear();
+  /**add a task, it starts after the tasks in after, return its id*/
+  int addTask(const string& name, const function<void()>& work,
+              const vector<int>& after= vector<int>());
+  /**run all added tasks and wait for them*/
+  void run();
+
+  /**wall time of the last run, the length of its critical path*/
+  double getFrameTime() const;
+  const vector<TASK_TIMING>& getTimings() const;
+  /**one line with the time of every task, for the log*/
+  string timingString() const;
+
+private:
+  struct TASK
+  {
+    string name;
+    function<void()> work;
+    vector<int> next;  // tasks waiting on this one
+    int waiting;       // unfinished tasks this one waits on
+    double ms;
+  };
+
+  void workerLoop();
+  void finishTask(int id);
+
+  vector<thread> m_threads;
+  vector<TASK> m_tasks;
+  vector<int> m_ready;
+  int m_unfinished;
+  bool m_stop;
+  mutex m_mutex;
+  condition_variable m_task_cv;
+  condition_variable m_done_cv;
+
+  double m_frame_ms;
+  vector<TASK_TIMING> m_timings;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef RM_CHALLENGE_FRAME_CONTEXT_H
+#define RM_CHALLENGE_FRAME_CONTEXT_H
+
+#include <opencv2/core/core.hpp>
+#include "opencv2/imgproc/imgproc.hpp"
+using namespace cv;
+
+#include <map>
+#include <mutex>
+#include <string>
+using namespace std;
+
+/**
+ * Derived images of one camera frame, computed on first use and shared
+ * by every detector that runs on the frame. Call reset() with each new
+ * frame, cached images are dropped then. The frame is BGR, or YUYV
+ * (CV_8UC2) from the v4l2 capture: then gray is its Y channel and BGR is
+ * only converted when a color detector asks for it.
+ * Returned images are shared, detectors must not write into them.
+ * Detectors of one frame may use it from several threads, reset() must
+ * not run while they do.
+ */
+class FrameContext
+{
+public:
+  FrameContext()
+    : m_is_yuyv(false)
+    , m_has_bgr(false)
+    , m_has_blurred(false)
+    , m_has_gray(false)
+    , m_has_gray_blurred(false)
+  {
+  }
+  FrameContext(const Mat& frame);
+
+  /**start a new frame, drop everything derived from the last one*/
+  void reset(const Mat& frame);
+
+  /**source BGR image, converted on first use from YUYV*/
+  const Mat& bgr();
+  /**5x5 gaussian blur of bgr, input of color extraction*/
+  const Mat& blurred();
+  /**gray of the frame, used by detectPillarArc and april tags*/
+  const Mat& gray();
+  /**3x3 box blur of gray, input of hough circles*/
+  const Mat& grayBlurred();
+
+  /**binary masks keyed by the detector, e.g. color and thresholds*/
+  bool findMask(const string& key, Mat& mask) const;
+  void storeMask(const string& key, const Mat& mask);
+
+private:
+  Mat m_yuyv;
+  bool m_is_yuyv;
+  Mat m_bgr;
+  Mat m_blurred;
+  Mat m_gray;
+  Mat m_gray_blurred;
+  bool m_has_bgr;
+  bool m_has_blurred;
+  bool m_has_gray;
+  bool m_has_gray_blurred;
+  map<string, Mat> m_masks;
+  /**each derived image has its own lock, so different ones are computed
+   * in parallel*/
+  mutex m_bgr_mutex;
+  mutex m_blurred_mutex;
+  mutex m_gray_mutex;
+  mutex m_gray_blurred_mutex;
+  mutable mutex m_masks_mutex;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef RM_CHALLENGE_FRAME_GRABBER_H
+#define RM_CHALLENGE_FRAME_GRABBER_H
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include "rm_challenge_v4l2_capture.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+using namespace std;
+
+/**
+ * Reads a cv::VideoCapture or a V4L2Capture on its own thread so the
+ * processing loop always gets the newest frame instead of the oldest one
+ * queued by v4l.
+ * Frames go through a lock free single producer / single consumer ring
+ * of three preallocated buffers: the capture thread fills one, one holds
+ * the newest frame and the processing loop owns the third. A frame that
+ * is replaced before it is taken counts as dropped.
+ * With a V4L2Capture the slots are the driver's buffers themselves, the
+ * frames are yuyv and never copied. A buffer goes back to the driver when
+ * the capture thread gets its slot back.
+ * A waiting processing loop sleeps on a condition variable that the
+ * capture thread signals with each frame, the ring itself takes no lock.
+ */
+class FrameGrabber
+{
+public:
+  /**rewind_frame: for video files, position to restart from at the end,
+   * -1 to stop. max_fps: limit of the capture rate, 0 for none*/
+  FrameGrabber(cv::VideoCapture& cap, int rewind_frame= -1,
+               double max_fps= 0);
+  FrameGrabber(V4L2Capture& capture);
+  ~FrameGrabber();
+
+  void start();
+  void stop();
+
+  /**wait up to timeout seconds for a frame newer than the last one
+   * returned. frame stays valid until the next call*/
+  bool getNewestFrame(cv::Mat& frame, double timeout);
+  /**wall clock time in seconds the last returned frame was captured at*/
+  double getFrameStamp() const;
+
+  /**counters since start*/
+  unsigned long getCapturedCount() const;
+  unsigned long getDeliveredCount() const;
+  unsigned long getDroppedCount() const;
+  unsigned long getFailedCount() const;
+
+private:
+  void captureLoop();
+  /**wake getNewestFrame, after a new frame or when the capture stops*/
+  void notifyFrame();
+  /**capture into slot, false on failure*/
+  bool readFrame(int slot);
+
+  /**slot index in the low bits, FRESH when not yet taken*/
+  enum
+  {
+    SLOT_MASK= 3,
+    FRESH= 4
+  };
+
+  /**one of the two is used*/
+  cv::VideoCapture* m_cap;
+  V4L2Capture* m_v4l2;
+  int m_rewind_frame;
+  double m_max_fps;
+  cv::Mat m_slots[3];
+  double m_stamps[3];
+  /**v4l2 buffer held by each slot, -1 for none*/
+  int m_buffers[3];
+  /**slot being filled, only used by the capture thread*/
+  int m_back;
+  /**slot with the newest frame, exchanged by both threads*/
+  atomic<int> m_middle;
+  /**slot owned by the processing loop*/
+  int m_front;
+
+  thread m_thread;
+  atomic<bool> m_running;
+  /**only guard the wait for a fresh frame, not the slots*/
+  mutex m_frame_mutex;
+  condition_variable m_frame_cv;
+  atomic<unsigned long> m_captured;
+  atomic<unsigned long> m_delivered;
+  atomic<unsigned long> m_dropped;
+  atomic<unsigned long> m_failed;
+};
+
+#endif
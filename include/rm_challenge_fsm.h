@@ -24,6 +24,18 @@ start2,base5,pillar5,(qulification),3
 #define PA_LANDPOINT_POSITION_ERROR 4.0
 #define PA_GRASPPER_CONTROL_TIME 1
 #define PA_GO_UP_VELOCITY 0.3
+/*waits of the state actions in seconds, run() checks them on every tick
+ * instead of sleeping*/
+#define PA_TAKEOFF_RETRY_TIME 1.0
+#define PA_GRASPPER_MOVE_TIME 2.0
+#define PA_RELEASE_BALL_OPEN_TIME 1.5
+#define PA_RELEASE_BALL_WAIT_TIME 2.5
+#define PA_FINAL_OPEN_TIME 1.0
+#define PA_DROP_DOWN_TIME 0.4
+#define PA_RESET_TIME 1.0
+/*the checks and actions of every tick print to rosout at most once per
+ * this many seconds each, the event log has every tick*/
+#define PA_LOG_PERIOD 0.5
 
 #define PA_BRIDGE_HEIGHT 0.8  // set to lower than real
 #define PA_FLYING_HEIGHT 2.7
@@ -105,6 +117,14 @@ start2,base5,pillar5,(qulification),3
 #include <std_msgs/Float32.h>
 #include <sstream>
 #include "std_msgs/String.h"
+#include "test2/BaseResult.h"
+#include "test2/LineResult.h"
+#include "test2/PillarResult.h"
+#include "rm_challenge_event_log.h"
+#include "rm_challenge_latency_tracer.h"
+#include "rm_challenge_seqlock.h"
+#include "rm_challenge_state_estimator.h"
+#include "rm_challenge_serial_commander.h"
 // C++标准库
 #include <math.h>
 #include <fstream>
@@ -142,6 +162,7 @@ public:
     TRACK_LINE_FORWARD,
     TRACK_LINE_BACKWARD,  // 12
     FINAL,
+    STATE_NUM
   };
   enum GRASPPER_STATE
   {
@@ -182,6 +203,8 @@ public:
   };
   RMChallengeFSM()
   {
+    for(int i= 0; i < INPUT_NUM; i++)
+      m_applied_input[i]= 0;
   }
   ~RMChallengeFSM();
   void run();
@@ -189,10 +212,8 @@ public:
   void resetAllState();
 
 private:
-  /**serial port*/
-  boost::asio::serial_port *m_serial_port;
-  boost::system::error_code m_err_code;
-  boost::asio::io_service m_io_service;
+  /**serial port, written on its own thread*/
+  SerialCommander m_serial;
 
 /**dji sdk */
 #if CURRENT_COMPUTER == MANIFOLD
@@ -210,29 +231,19 @@ private:
 
   /**subscribe from dji's nodes*/
   UAV_STATE m_uav_state= UAV_LAND;
-  float m_current_height_from_guidance;
   /**
-  raw_position=real_position+bias
-  bias=raw - real
+  position, height and the vision position errors fused from guidance
+  and vision, raw_position=real_position+bias
   */
-  float m_real_position[2];  // initial
-  float m_guidance_bias[2];
-  float m_raw_guidance_position[2];
+  StateEstimator m_estimator;
+  /**the estimate at the time of the current tick, run() reads only this*/
+  UAV_ESTIMATE m_estimate;
 
   /**subscribe from vision node about circle,arc and triangle*/
-  bool m_discover_pillar_circle;
-  bool m_discover_pillar_arc;
-  float m_circle_position_error[2];
-  float m_current_height_from_circle;
-  float m_arc_position_error[2];
-  float m_current_height_from_arc;
   int m_pillar_triangle[4];
   PILLAR_COLOR m_first_pillar_color;
 
   /**subscribe from  vision node about base*/
-  bool m_discover_base;
-  float m_base_position_error[2];
-  float m_base_angle;
   BASE_STATE m_base_state;
 
   /**subscribe from vision node about detectLine*/
@@ -261,6 +272,148 @@ private:
   ros::Publisher m_pillar_change_pub;
   ros::Publisher m_line_change_pub;
   ros::Publisher m_base_change_pub;
+  /**age of the vision data when it arrives, when run() uses it and when
+   * it turns into a velocity command, published on tpp/latency/uav*/
+  LatencyTracer m_latency;
+  /**capture stamp of the newest vision result*/
+  ros::Time m_vision_stamp;
+  /**state last printed to rosout, it is only printed when it changes*/
+  int m_printed_state;
+  /**step of the action sequence of the current state and the time its
+   * wait ends, both cleared by transferToTask*/
+  int m_action_step;
+  ros::Time m_action_deadline;
+  /**resetAllState does nothing before this, see PA_RESET_TIME*/
+  ros::Time m_next_reset_time;
+
+  /**inputs from the callbacks. The setters run on the callback threads
+   * and only store them, each in its own seqlock, run() applies the ones
+   * that changed at the start of the tick on the control thread*/
+  enum INPUT_ID
+  {
+    INPUT_DRONE_STATE,
+    INPUT_HEIGHT,
+    INPUT_POSITION,
+    INPUT_PILLAR,
+    INPUT_BASE,
+    INPUT_LINE,
+    INPUT_NUM
+  };
+  struct HEIGHT_INPUT
+  {
+    double stamp;
+    float height;
+  };
+  struct POSITION_INPUT
+  {
+    double stamp;
+    float x;
+    float y;
+  };
+  struct PILLAR_INPUT
+  {
+    double stamp;
+    bool circle_found;
+    float circle_position[2];
+    float height;
+    int triangle[4];
+    bool arc_found;
+    float arc_position[2];
+  };
+  struct BASE_INPUT
+  {
+    double stamp;
+    bool found;
+    float position[2];
+    float angle;
+  };
+  struct LINE_INPUT
+  {
+    double stamp;
+    bool T_found;
+    float distance[2];
+    float normal[2];
+  };
+  SeqLock<int> m_drone_state_input;
+  SeqLock<HEIGHT_INPUT> m_height_input;
+  SeqLock<POSITION_INPUT> m_position_input;
+  SeqLock<PILLAR_INPUT> m_pillar_input;
+  SeqLock<BASE_INPUT> m_base_input;
+  SeqLock<LINE_INPUT> m_line_input;
+  /**write count of each input when it was last applied*/
+  unsigned m_applied_input[INPUT_NUM];
+
+  /**conditions of the transition table. A tick evaluates each one at
+   * most once, in this order, the value is kept until the next tick*/
+  enum CONDITION
+  {
+    C_WAITING,
+    C_TAKING_OFF,
+    C_TAKEOFF_TIMEOUT,
+    C_FROM_START,
+    C_ON_LAND,
+    C_GOAL_HEIGHT,
+    C_FAR_FROM_TAKEOFF,
+    C_LAND_POINT,
+    C_STILL_LAND_POINT,
+    C_YELLOW_LINE,
+    C_T,
+    C_NEXT_CLOSE_PILLAR,
+    C_NEXT_FAR_PILLAR,
+    C_NEXT_BASE,
+    C_SETPOINT,
+    C_READY_TO_LAND,
+    C_PILLAR_LAND_POINT,
+    C_BASE_LAND_POINT,
+    C_QULIFYING,
+    C_LAST_TRAVEL,
+    C_GRAB_FINISHED,
+    C_RELEASE_HEIGHT,
+    C_FORWARD_ENOUGH,
+    C_BACKWARD_ENOUGH,
+    CONDITION_NUM
+  };
+  /**
+   * One row of the transition table: in state at action step, when the
+   * conditions in when_true hold and those in when_false do not, run
+   * action and go to next. The rows of a state are tried in order and
+   * the first match wins, no match does nothing this tick.
+   */
+  struct TRANSITION
+  {
+    TASK_STATE state;
+    int step;
+    unsigned when_true;   // bit per CONDITION
+    unsigned when_false;  // bit per CONDITION
+    void (RMChallengeFSM::*action)();
+    TASK_STATE next;  // state itself to stay, keeping the action step
+  };
+  struct STATE_INFO
+  {
+    const char *name;   // printed on rosout
+    const char *stage;  // in the latency report
+    /**run on every tick of the state before its rows, or NULL*/
+    void (RMChallengeFSM::*during)();
+  };
+  static const TRANSITION s_transitions[];
+  static const int s_transition_num;
+  static const STATE_INFO s_state_info[STATE_NUM];
+  static bool (RMChallengeFSM::*const s_conditions[CONDITION_NUM])();
+  /**rows of each state in s_transitions*/
+  int m_first_transition[STATE_NUM];
+  int m_transition_num[STATE_NUM];
+  /**conditions evaluated this tick and their values*/
+  unsigned m_condition_known;
+  unsigned m_condition_value;
+  /**current visit of m_state: when it began, its ticks and their cost*/
+  ros::Time m_state_enter_time;
+  int m_state_ticks;
+  double m_state_tick_ms;
+  double m_state_tick_max_ms;
+  /**latency report stages of each state, cost of a tick and time spent
+   * in one visit, both in ms*/
+  string m_tick_stage[STATE_NUM];
+  string m_visit_stage[STATE_NUM];
 
 private:
   /**uav state checking method*/
@@ -289,6 +442,38 @@ private:
   bool forwardFarEnough();
   bool backwardFarEnough();
   bool isQulifying();
+  /**non blocking wait of the current state, isWaiting() until seconds
+   * passed*/
+  void startWait(double seconds);
+  bool isWaiting();
+  bool takeoffFromStart();
+
+  /**transition table engine*/
+  void indexTransitions();
+  bool checkCondition(CONDITION condition);
+  bool matchTransition(const TRANSITION &transition);
+  /**run the during action and the first matching row of m_state,
+   * returns the state to go to*/
+  TASK_STATE runTransitions();
+  /**start timing a visit of m_state, report the one that ends*/
+  void beginStateVisit();
+  void endStateVisit();
+
+  /**actions of the transition table*/
+  void startTakeoff();
+  void updateVisionTaskAndColor();
+  void trackLineFromT();
+  void startDropDown();
+  void leaveBase();
+  void landWithGraspperOpen();
+  void startGrabBall();
+  void finishGrabBall();
+  void startReleaseBall();
+  void finishReleaseBall();
+  void openFinalGraspper();
+  void droneGoForward();
+  void droneGoBackward();
+  void nextTakeoffPoint();
 
   /**uav control method*/
   void droneTakeoff();
@@ -313,12 +498,11 @@ private:
                                                           // direction
   void unitifyVector(float &x, float &y);  // tested
   void judgeLineDirection();
-  void calculateRealPositionError(float error[2]);
+  void calculateRealPositionError(float error[2], float height);
   void navigateByTriangle(float &x, float &y, float &z);  // tested
   void navigateByCircle(float &x, float &y, float &z);    // tested
   void navigateByArc(float &x, float &y, float &z);
   void publishVelocity(std::string id, float x, float y, float z);
-  void droneReleaseBall();
   void droneGoDownToBase();
   void droneGoToPillar();
   void updateTakeoffPointId();
@@ -336,24 +520,40 @@ private:
   void updateTPosition();
   void navigateByQRCode(float &x, float &y, float &z, float &yaw);
   void publishPosition();
+  /**newest vision result used by the tick was captured at stamp*/
+  void updateVisionStamp(const ros::Time &stamp);
 
-public:
-  /**update from dji's nodes*/
-  void setDroneState(int state);
-  void setHeightFromGuidance(float height);
-  void setPositionFromGuidance(float x, float y);  //考虑漂移，m_bias
-  /**update from topic about circle and triangle*/
-  void setCircleVariables(bool is_circle_found, float position_error[2],
-                          float height);
+  /**copy the inputs that changed since the last tick into the state*/
+  void applyInputs();
+  void applyDroneState(int state);
+  void applyPositionFromGuidance(double stamp, float x, float y);
+  /**update from topic about circle and triangle, stamp is the capture
+   * time of the frame*/
+  void setCircleVariables(double stamp, bool is_circle_found,
+                          float position_error[2], float height);
   void setTriangleVariables(int pillar_triangle[4]);
-  void setArcVariables(bool is_arc_found, float position_error[2]);
+  void setArcVariables(double stamp, bool is_arc_found,
+                       float position_error[2]);
   /**update from topic about base */
-  void setBaseVariables(bool is_base_found, float position_error[2],
-                        float base_angle);
+  void setBaseVariables(double stamp, bool is_base_found,
+                        float position_error[2], float base_angle);
   /**update from topic about detectLine*/
   void setLineVariables(bool is_T_found, float distance_to_line[2],
                         float line_normal[2]);
 
+public:
+  /**update from dji's nodes, safe on any callback thread. stamp is the
+   * time of the measurement, zero for now*/
+  void setDroneState(int state);
+  void setHeightFromGuidance(float height,
+                             const ros::Time &stamp= ros::Time(0));
+  void setPositionFromGuidance(float x, float y,
+                               const ros::Time &stamp= ros::Time(0));
+  /**update from the typed vision results, safe on any callback thread*/
+  void setPillarResult(const test2::PillarResult &result);
+  void setBaseResult(const test2::BaseResult &result);
+  void setLineResult(const test2::LineResult &result);
+
   void setFirstPillarColor(PILLAR_COLOR color);
   void transformCoordinate(float phi, float &x, float &y);
 };
@@ -0,0 +1,37 @@
+#ifndef RM_CHALLENGE_IMAGE_MAILBOX_H
+#define RM_CHALLENGE_IMAGE_MAILBOX_H
+
+#include <cv_bridge/cv_bridge.h>
+
+#include <condition_variable>
+#include <mutex>
+using namespace std;
+
+/**
+ * Hands the newest image from the subscriber callback to the processing
+ * loop. The callback posts, the loop sleeps in take() until there is an
+ * image it has not seen. One slot: an image the loop had no time for is
+ * replaced by the next one, so the loop always works on the newest frame.
+ * The images are shared, not copied.
+ */
+class ImageMailbox
+{
+public:
+  ImageMailbox();
+
+  /**replace the waiting image and wake the loop*/
+  void post(const cv_bridge::CvImageConstPtr& image);
+  /**wait up to timeout seconds for a new image, false on timeout*/
+  bool take(cv_bridge::CvImageConstPtr& image, double timeout);
+
+  /**images replaced before they were taken*/
+  unsigned long getDroppedCount();
+
+private:
+  cv_bridge::CvImageConstPtr m_image;
+  unsigned long m_dropped;
+  mutex m_mutex;
+  condition_variable m_cv;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef RM_CHALLENGE_IMAGE_PUBLISHER_H
+#define RM_CHALLENGE_IMAGE_PUBLISHER_H
+
+#include <opencv2/core/core.hpp>
+
+#include <image_transport/image_transport.h>
+#include <ros/ros.h>
+
+#include <string>
+using namespace std;
+
+/**
+ * Publishes debug images only when they are wanted. Nothing is converted
+ * when the topic has no subscribers. Each topic reads its own parameters
+ * from the private namespace, e.g. ~m100/image/max_rate:
+ *   max_rate: images per second at most, 0 for every frame
+ *   scale: size of the published image relative to the frame
+ *   gray: publish mono8 instead of bgr8
+ * Compressed variants come from the image_transport plugins on
+ * <topic>/compressed, and those subscribers are counted too.
+ */
+class ImagePublisher
+{
+public:
+  ImagePublisher();
+
+  void advertise(ros::NodeHandle& node, ros::NodeHandle& config_node,
+                 const string& topic);
+
+  /**publish a bgr or yuyv frame, false when it was skipped*/
+  bool publish(const cv::Mat& frame, const ros::Time& stamp);
+
+private:
+  image_transport::Publisher m_pub;
+  double m_max_rate;
+  double m_scale;
+  bool m_gray;
+  ros::WallTime m_last_time;
+  /**downscaled frame before gray conversion, converted yuyv before
+   * scaling*/
+  cv::Mat m_small;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef RM_CHALLENGE_LATENCY_TRACER_H
+#define RM_CHALLENGE_LATENCY_TRACER_H
+
+#include <ros/ros.h>
+#include "test2/LatencyReport.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * Rolling latency histogram per stage. Each stage records how old the
+ * capture stamp of the frame it works on is, so the stages from camera
+ * to velocity command can be compared on one time axis. The p50, p95 and
+ * p99 of the last window samples of every stage are published
+ * periodically as test2/LatencyReport. record may be called from any
+ * thread.
+ */
+class LatencyTracer
+{
+public:
+  LatencyTracer(int window= 512);
+
+  /**publish a report on topic every period seconds*/
+  void advertise(ros::NodeHandle& node, const string& topic, double period);
+
+  /**age of capture_stamp now, zero stamps are ignored*/
+  void record(const string& stage, const ros::Time& capture_stamp);
+  void addSample(const string& stage, double ms);
+
+  void fillReport(test2::LatencyReport& report);
+  string reportString();
+
+private:
+  struct STAGE
+  {
+    string name;
+    vector<float> samples; // ring of the last window samples
+    int next;
+    unsigned long count;
+  };
+
+  STAGE& findStage(const string& name);
+  void publishCallback(const ros::TimerEvent& evt);
+
+  int m_window;
+  vector<STAGE> m_stages;
+  mutex m_mutex;
+
+  ros::Publisher m_pub;
+  ros::Timer m_timer;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef RM_CHALLENGE_SEQLOCK_H
+#define RM_CHALLENGE_SEQLOCK_H
+
+#include <atomic>
+using namespace std;
+
+/**
+ * Latest value of an input, written by one callback thread and read by
+ * the control thread. The writer never waits, a reader copies again when
+ * a write went on meanwhile, so reading costs a copy of T and no lock.
+ * T must be plain data, no pointers or strings.
+ */
+template <typename T>
+class SeqLock
+{
+public:
+  SeqLock() : m_seq(0), m_value()
+  {
+  }
+
+  /**only one thread may write*/
+  void write(const T& value)
+  {
+    unsigned seq= m_seq.load(memory_order_relaxed);
+    /*odd while the value is being written*/
+    m_seq.store(seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    m_value= value;
+    m_seq.store(seq + 2, memory_order_release);
+  }
+
+  /**copy of the newest value, returns the number of writes before it*/
+  unsigned read(T& value) const
+  {
+    unsigned begin, end;
+    do
+    {
+      begin= m_seq.load(memory_order_acquire);
+      value= m_value;
+      atomic_thread_fence(memory_order_acquire);
+      end= m_seq.load(memory_order_relaxed);
+    } while((begin & 1) || begin != end);
+    return begin / 2;
+  }
+
+private:
+  atomic<unsigned> m_seq;
+  T m_value;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef RM_CHALLENGE_SERIAL_COMMANDER_H
+#define RM_CHALLENGE_SERIAL_COMMANDER_H
+
+#include <boost/asio.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+using namespace std;
+
+/**devices behind the uart, each keeps the last command it got*/
+enum SERIAL_CHANNEL
+{
+  SERIAL_GRASPPER,
+  SERIAL_LED,
+  SERIAL_CHANNEL_NUM
+};
+
+/**
+ * One byte commands to the graspper and led board over the uart. A thread
+ * of its own writes them, send() only queues and returns, so no control
+ * callback waits for the 9600 baud line.
+ * Each channel holds one command: a new one replaces the command not
+ * written yet, the same command again is dropped while its writes are
+ * still going on. Bytes get lost on the line, so a command is written
+ * repeat times, retry_period seconds apart, and the same command sent
+ * after that is written repeat times again.
+ */
+class SerialCommander
+{
+public:
+  SerialCommander(int repeat= 10, double retry_period= 0.02);
+  ~SerialCommander();
+
+  /**open the port 8N1 and start the writer thread*/
+  bool open(const string& device, int baud_rate);
+  /**stop the writer, commands not written yet are dropped*/
+  void close();
+
+  void send(SERIAL_CHANNEL channel, char command);
+
+  /**counters since open*/
+  unsigned long getWrittenCount() const;
+  unsigned long getCoalescedCount() const;
+  unsigned long getFailedCount() const;
+
+private:
+  struct COMMAND
+  {
+    char byte;
+    bool valid;
+    int left;  // writes still to do
+    chrono::steady_clock::time_point next;
+  };
+
+  void writeLoop();
+
+  int m_repeat;
+  chrono::steady_clock::duration m_retry_period;
+  COMMAND m_commands[SERIAL_CHANNEL_NUM];
+
+  boost::asio::io_service m_io_service;
+  boost::asio::serial_port m_port;
+
+  thread m_thread;
+  bool m_running;
+  mutex m_mutex;
+  condition_variable m_cv;
+
+  atomic<unsigned long> m_written;
+  atomic<unsigned long> m_coalesced;
+  atomic<unsigned long> m_failed;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef RM_CHALLENGE_STATE_ESTIMATOR_H
+#define RM_CHALLENGE_STATE_ESTIMATOR_H
+
+/*alpha beta gains, how much of the innovation goes into the value and
+ * the rate. Guidance is smooth, vision jumps between frames*/
+#define PA_ESTIMATOR_POSITION_ALPHA 0.6
+#define PA_ESTIMATOR_POSITION_BETA 0.1
+#define PA_ESTIMATOR_HEIGHT_ALPHA 0.6
+#define PA_ESTIMATOR_HEIGHT_BETA 0.1
+#define PA_ESTIMATOR_VISION_ALPHA 0.5
+#define PA_ESTIMATOR_VISION_BETA 0.05
+/*a measurement this many seconds after the last one restarts the filter*/
+#define PA_ESTIMATOR_MAX_GAP 0.5
+/*prediction is extrapolated at most this far past a measurement*/
+#define PA_ESTIMATOR_MAX_PREDICT 0.2
+/*a vision target not seen for this long counts as lost*/
+#define PA_ESTIMATOR_VISION_TIMEOUT 1.0
+/*filtered heights kept to look up the height at a frame's capture time,
+ * they must span more than the vision latency*/
+#define PA_ESTIMATOR_HEIGHT_HISTORY 32
+
+/**
+ * Value and rate of one measured quantity, an alpha beta filter over
+ * timestamped measurements. predict() extrapolates with the rate.
+ */
+class AlphaBetaFilter
+{
+public:
+  AlphaBetaFilter(float alpha= 0.5, float beta= 0.1);
+
+  void update(double stamp, float value);
+  /**start again from value, with no rate*/
+  void reset(double stamp, float value);
+  float predict(double stamp) const;
+
+  bool isValid() const;
+  double getStamp() const;
+  float getRate() const;
+
+private:
+  float m_alpha;
+  float m_beta;
+  bool m_valid;
+  double m_stamp;
+  float m_value;
+  float m_rate;
+};
+
+/**state of the uav predicted to one control instant*/
+struct UAV_ESTIMATE
+{
+  double stamp;
+  /**arena position, guidance minus its bias, and velocity*/
+  float position[2];
+  float velocity[2];
+  /**height from guidance*/
+  float height;
+  float height_rate;
+  /**vision position errors in meters, zero when the target is lost*/
+  bool circle_found;
+  float circle_error[2];
+  float circle_height;
+  bool arc_found;
+  float arc_error[2];
+  bool base_found;
+  float base_error[2];
+  float base_angle;
+};
+
+/**one filtered height and the time of its measurement*/
+struct HEIGHT_SAMPLE
+{
+  double stamp;
+  float height;
+};
+
+/**
+ * Fuses the guidance position and height and the vision position errors
+ * into one state. Every measurement comes with the time it was taken,
+ * vision with the capture time of its frame, and predict() moves them all
+ * to the control instant. The guidance bias is kept here: on land it
+ * follows the guidance drift, in the air it is subtracted once per
+ * position measurement.
+ * Not thread safe, the FSM feeds and reads it on its control thread.
+ */
+class StateEstimator
+{
+public:
+  StateEstimator();
+
+  /**guidance position in the arena axes. on land it only moves the bias,
+   * the uav stays where it was put by setPosition*/
+  void updateGuidancePosition(double stamp, float x, float y, bool on_land);
+  void updateHeight(double stamp, float height);
+  void updateCircle(double stamp, bool found, float error_x, float error_y,
+                    float height);
+  void updateArc(double stamp, bool found, float error_x, float error_y);
+  void updateBase(double stamp, bool found, float error_x, float error_y,
+                  float angle);
+
+  /**the uav is known to be at x, y, e.g. on a takeoff point*/
+  void setPosition(float x, float y);
+  /**forget all vision targets*/
+  void resetVision();
+
+  /**height at a past stamp, to scale the vision measured then.
+   * Interpolated between the filtered heights around stamp, the oldest
+   * kept one before them and predicted after the newest*/
+  float getHeightAt(double stamp) const;
+  const float* getGuidanceBias() const;
+
+  /**the state at stamp*/
+  void predict(double stamp, UAV_ESTIMATE& estimate) const;
+
+private:
+  void updateTarget(AlphaBetaFilter* filter, double stamp, bool found,
+                    float error_x, float error_y);
+  void predictTarget(const AlphaBetaFilter* filter, double stamp,
+                     bool& found, float error[2]) const;
+
+  AlphaBetaFilter m_position[2];
+  float m_raw_position[2];
+  float m_bias[2];
+  AlphaBetaFilter m_height;
+  /**ring of the last filtered heights, oldest at m_height_head*/
+  HEIGHT_SAMPLE m_height_history[PA_ESTIMATOR_HEIGHT_HISTORY];
+  int m_height_head;
+  int m_height_num;
+  AlphaBetaFilter m_circle[2];
+  bool m_circle_found;
+  float m_circle_height;
+  AlphaBetaFilter m_arc[2];
+  bool m_arc_found;
+  AlphaBetaFilter m_base[2];
+  bool m_base_found;
+  float m_base_angle;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef RM_CHALLENGE_V4L2_CAPTURE_H
+#define RM_CHALLENGE_V4L2_CAPTURE_H
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * Camera capture straight from a v4l2 device with mmap streaming buffers.
+ * The camera delivers YUYV, a frame is a CV_8UC2 cv::Mat header over the
+ * driver's buffer, nothing is copied or converted on capture. Gray is the
+ * Y channel of it, BGR is only computed by whoever needs color, see
+ * FrameContext.
+ * Exposure and gain are set once at open, auto exposure would change the
+ * frame interval with the light.
+ */
+class V4L2Capture
+{
+public:
+  V4L2Capture();
+  ~V4L2Capture();
+
+  /**open the device and start streaming. exposure in 100us units,
+   * exposure or gain < 0 leaves the camera's automatic control on*/
+  bool open(const string& device, int width, int height, double fps,
+            int exposure= -1, int gain= -1);
+  void close();
+  bool isOpened() const;
+
+  /**wait up to timeout seconds for a filled buffer. frame is a yuyv
+   * header over it, valid until release(index). stamp is the wall clock
+   * time in seconds the driver captured it at*/
+  bool dequeue(int& index, cv::Mat& frame, double& stamp, double timeout);
+  /**give the buffer back to the driver*/
+  void release(int index);
+
+  cv::Size getSize() const;
+
+private:
+  bool setControl(int id, int value);
+
+  int m_fd;
+  int m_width;
+  int m_height;
+  vector<void*> m_buffers;
+  vector<size_t> m_lengths;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef RM_CHALLENGE_VIDEO_RECORDER_H
+#define RM_CHALLENGE_VIDEO_RECORDER_H
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/**
+ * Records frames to a video file on its own thread, so encoding never
+ * runs in the processing loop. write() only copies the frame into one of
+ * queue_size preallocated slots. When all slots are waiting to be
+ * encoded the frame is dropped instead of blocking the caller. YUYV
+ * frames are converted to BGR on the encoding thread.
+ */
+class VideoRecorder
+{
+public:
+  VideoRecorder(int queue_size= 8);
+  ~VideoRecorder();
+
+  /**open the file and start the encoding thread*/
+  bool open(const string& file_name, int fourcc, double fps, cv::Size size);
+  /**encode the queued frames, then close the file*/
+  void close();
+  bool isOpened() const;
+
+  /**queue a copy of frame, false when it was dropped*/
+  bool write(const cv::Mat& frame);
+
+  /**frames waiting to be encoded*/
+  int getBacklog();
+  /**largest backlog since open*/
+  int getMaxBacklog();
+  unsigned long getWrittenCount();
+  unsigned long getDroppedCount();
+
+private:
+  void encodeLoop();
+
+  cv::VideoWriter m_writer;
+  /**ring of frames, m_count slots from m_head are waiting*/
+  vector<cv::Mat> m_slots;
+  /**bgr of a yuyv slot, only used by the encoding thread*/
+  cv::Mat m_bgr;
+  int m_head;
+  int m_count;
+  int m_max_count;
+  bool m_stop;
+  unsigned long m_written;
+  unsigned long m_dropped;
+
+  thread m_thread;
+  mutex m_mutex;
+  condition_variable m_cv;
+};
+
+#endif
@@ -14,6 +14,8 @@ using namespace cv;
 #include <cmath>
 #include <stdlib.h>
 #include <string>
+#include <algorithm>
+#include <mutex>
 using namespace std;
 
 #include <ros/ros.h>
@@ -21,13 +23,29 @@ using namespace std;
 #include <cv_bridge/cv_bridge.h>
 #include <image_transport/image_transport.h>
 
+#include "rm_challenge_event_log.h"
+#include "rm_challenge_frame_context.h"
+
 class LeastSquare;
 
+/**side of the box used as yellow density around a T junction, same
+ * variance as the 71x71 gaussian (sigma 11) it replaces*/
+#define T_BOX 37
+
+/**
+ * Pillar and yellow line detectors. All state kept between calls (color
+ * thresholds, the tracked arc, the T counter) lives in the instance, so
+ * use one instance per thread, detectors of different instances can run
+ * in parallel. The color table is shared by all instances and read only
+ * once the first constructor built it. Debug windows (visable) are only
+ * safe from one thread.
+ */
 class RMChallengeVision
 {
 public:
   RMChallengeVision()
   {
+    initColorLut();
   }
   RMChallengeVision(bool visable);
   enum COLOR_TYPE
@@ -46,15 +64,32 @@ public:
     float radius;
     float arc_radius;
   };
+  /**statistics of one connected blob, see labelBlobs*/
+  struct BLOB_STAT
+  {
+    int area;
+    Rect bbox;
+    Point2f centroid;
+    /**raw moments sum(x), sum(y), sum(x*x), sum(x*y), sum(y*y)*/
+    long long m10, m01, m20, m11, m02;
+    bool touch_border;
+  };
   /**p0 angle point,return the cosine of angle*/
   int detectPillar(Mat src, COLOR_TYPE color, PILLAR_RESULT& pillar_result);
+  int detectPillar(FrameContext& frame, COLOR_TYPE color,
+                   PILLAR_RESULT& pillar_result);
   float angle(Point pt1, Point pt2, Point pt0);
   void detectTriangle(Mat src, Mat color_region, int triangle[4]);
   void detectPillarCircle(Mat src, Mat color_region, bool& circle_found,
                           Point2f& circle_center, float& rad);
-  void detectPillarArc(Mat src, Mat color_region, bool& circle_found,
-                       Point2f& circle_center, float& radius);
+  void detectPillarArc(FrameContext& frame, Mat color_region,
+                       bool& circle_found, Point2f& circle_center,
+                       float& radius);
   void extractColor(Mat src, COLOR_TYPE color, Mat& colorRegion);
+  void extractColor(FrameContext& frame, COLOR_TYPE color, Mat& colorRegion);
+  void labelBlobs(const Mat& mask, uchar value, bool eight_connected,
+                  Mat& labels, vector<BLOB_STAT>& blobs);
+  void removeSmallBlobs(Mat& mask, int min_area, vector<BLOB_STAT>& kept);
   float imageToRealDistance(float imageLength, float imageDistance,
                             float realLength);
   float imageToHeight(float imageLength, float realLength);
@@ -62,19 +97,66 @@ public:
   /**yellow line related functions*/
   void getYellowRegion(Mat& src, Mat& dst, int h_low= 30, int h_high= 75,
                        int s_threshold= 80, int v_threshold= 80);
+  void getYellowRegion(FrameContext& frame, Mat& dst, int h_low= 30,
+                       int h_high= 75, int s_threshold= 80,
+                       int v_threshold= 80);
   void detectLine(Mat& src, float& distance_x, float& distance_y,
                   float& line_vector_x, float& line_vector_y);
+  void detectLine(FrameContext& frame, float& distance_x, float& distance_y,
+                  float& line_vector_x, float& line_vector_y);
   bool detectLineWithT(Mat& src, float& distance_x, float& distance_y,
                        float& line_vector_x, float& line_vector_y);
+  bool detectLineWithT(FrameContext& frame, float& distance_x,
+                       float& distance_y, float& line_vector_x,
+                       float& line_vector_y);
   bool getRectSide(Mat& src, vector<uchar>& side, int x, int y, int r);
   bool isTri(Mat& src, int x, int y, int r);
-  bool hasTri(Mat& src, int r, int val_max);
+  bool isTri(const Mat& sum, int x, int y, int r, int half, int thresh);
+  bool hasTri(const Mat& sum, int half, int r, int val_max);
 
   /**set visability*/
   void setVisability(bool visable);
 
 private:
   bool m_visable= true;
+
+  /**thresholds of extractColor, also the trackbar values*/
+  int m_low_h= 0;
+  int m_high_h= 180;
+  int m_low_s= 0;
+  int m_high_s= 255;
+  int m_low_v= 0;
+  int m_high_v= 255;
+  int m_bgr_thresh1= 0;
+  int m_bgr_thresh2= 0;
+
+  /**circle tracked by detectPillarArc*/
+  float m_arc_last_radius= 100;
+  Point2f m_arc_last_center;
+  bool m_arc_last_found= false;
+  Point2f m_arc_last_hough_center;
+
+  /**T found count of hasTri*/
+  int m_T_cnt= 0;
+
+  /**color lookup table shared by all instances, index (b<<16)|(g<<8)|r,
+   * one bit per color class. The classes are the thresholds the detectors
+   * use, all built by the first constructor, before any frame. Other
+   * thresholds (debug trackbar) run the kernel on the frame instead*/
+  enum
+  {
+    LUT_PARAM_NUM= 11,
+    LUT_CLASS_NUM= 8
+  };
+  typedef void (*MaskKernel)(const Mat& bgr, const int params[], Mat& mask);
+  static void initColorLut();
+  static void addColorLut(const int params[], MaskKernel kernel);
+  /**bit of the class with params, -1 when it is not in the table*/
+  static int findColorLut(const int params[]);
+  static void applyColorLut(const Mat& src, int bit, Mat& dst);
+  static vector<uchar> s_color_lut;
+  static int s_lut_params[LUT_CLASS_NUM][LUT_PARAM_NUM];
+  static int s_lut_class_num;
 };
 
 class LeastSquare
@@ -83,37 +165,25 @@ class LeastSquare
 public:
   bool is_kxb;
   float tx, ty;
-  LeastSquare(const vector<int>& x,
-              const vector<int>& y)  //构造函数，输入x，y坐标，得到斜率和截距
+  /**total least squares (PCA) fit from the moments of n points:
+   * sx=sum(x), sy=sum(y), sxx=sum(x*x), sxy=sum(x*y), syy=sum(y*y)*/
+  LeastSquare(long long n, long long sx, long long sy, long long sxx,
+              long long sxy, long long syy)
   {
-    float t1= 0, t2= 0, t3= 0, t4= 0, t5= 0;
-    for(int i= 0; i < (int)x.size(); ++i)
-    {
-      t1+= x[i] * x[i];
-      t2+= x[i];
-      t3+= x[i] * y[i];
-      t4+= y[i];
-      t5+= y[i] * y[i];
-    }
-    a= (t3 * x.size() - t2 * t4) / (t1 * x.size() - t2 * t2);
-    // b = (t4 - a*t2) / x.size();
-    b= (t1 * t4 - t2 * t3) / (t1 * x.size() - t2 * t2);
-
-    // t1=0, t2=0, t3=0, t4=0;
-    /*for(int i=0; i<(int)x.size(); ++i)
-    {
-        t1 += y[i]*y[i];
-        t2 += y[i];
-        t3 += y[i]*x[i];
-        t4 += x[i];
-    }  */
-    ah= (t3 * x.size() - t2 * t4) / (t5 * x.size() - t4 * t4);
-    // b = (t4 - a*t2) / x.size();
-    bh= (t5 * t2 - t4 * t3) / (t5 * x.size() - t4 * t4);
-    is_kxb= abs(a) < abs(ah);
-    // error = is_kxb?error1:error2;
-    // error = min(error1,error2);
-    // avg = error/x.size();
+    float mx= (double)sx / n, my= (double)sy / n;
+    //协方差，在64位整数上相减，不丢精度
+    double cxx= (double)(sxx * n - sx * sx);
+    double cxy= (double)(sxy * n - sx * sy);
+    double cyy= (double)(syy * n - sy * sy);
+    //主方向即直线方向
+    double theta= 0.5 * atan2(2 * cxy, cxx - cyy);
+    float dx= cos(theta), dy= sin(theta);
+    is_kxb= fabs(dy) <= fabs(dx);
+    //另一种形式在直线接近竖直或水平时用一个很大的斜率代替
+    a= fabs(dx) > 1e-6 ? dy / dx : 1e6;
+    ah= fabs(dy) > 1e-6 ? dx / dy : 1e6;
+    b= my - a * mx;
+    bh= mx - ah * my;
 
     if(is_kxb)
     {
@@ -145,29 +215,6 @@ public:
     return ah * y + bh;
   }
 
-  float
-  error_plan1(const vector<int>& x,
-              const vector<int>& y)  // y=kx+b方程误差计算（点到直线距离平方和）
-  {
-    float error= 0.0;
-    for(int i= 0; i < (int)x.size(); ++i)
-    {
-      error+= (a * x[i] + b - y[i]) * (a * x[i] + b - y[i]) / (a * a + 1);
-    }
-    return error;
-  }
-
-  float error_plan2(const vector<int>& x,
-                    const vector<int>& y)  // x=ah*y+bh方程误差计算
-  {
-    float error= 0.0;
-    for(int i= 0; i < (int)x.size(); ++i)
-    {
-      error+= (ah * y[i] + bh - x[i]) * (ah * y[i] + bh - x[i]) / (ah * ah + 1);
-    }
-    return error;
-  }
-
   float error_point(float& x, float& y)
   {
     if(is_kxb)
@@ -461,6 +461,14 @@ void QRCode::processImage(cv::Mat& image, cv::Mat& image_gray,
 
   // detect April tags (requires a gray scale image)
   cv::cvtColor(image, image_gray, CV_BGR2GRAY);
+  processGrayImage(image, image_gray, detections);
+}
+
+// same as processImage, with the gray image already converted, e.g. the
+// one shared through a FrameContext
+void QRCode::processGrayImage(cv::Mat& image, const cv::Mat& image_gray,
+                              vector<AprilTags::TagDetection>& detections)
+{
   double t0;
   if(m_timing)
   {
@@ -650,6 +658,23 @@ bool QRCode::getBasePosition(cv::Mat& src, float detections_height)
   return calculateBasePostion(detections_location, detections_distance);
 }
 
+bool QRCode::getBasePosition(FrameContext& frame, float detections_height)
+{
+  vector<cv::Point2f> detections_location;
+  vector<float> detections_distance;
+  vector<AprilTags::TagDetection> detections;
+
+  // the image is only drawn into, a yuyv frame is not converted to bgr
+  // when nothing is drawn
+  cv::Mat image;
+  if(m_draw)
+    image= frame.bgr().clone();
+  processGrayImage(image, frame.gray(), detections);
+  getDetectionLocationAndDistance(detections_location, detections_distance,
+                                  detections_height, detections);
+  return calculateBasePostion(detections_location, detections_distance);
+}
+
 float QRCode::getBaseX()
 {
   return base_position_x - 1.05;
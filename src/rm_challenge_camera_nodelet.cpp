@@ -0,0 +1,166 @@
+#include "rm_challenge_camera_pipeline.h"
+#include "rm_challenge_event_log.h"
+#include "rm_challenge_frame_grabber.h"
+#include "rm_challenge_v4l2_capture.h"
+#include "rm_challenge_video_recorder.h"
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/file_log.h>
+
+#include <memory>
+
+namespace rm_challenge
+{
+/**
+ * Camera node as a nodelet. Loaded into the same manager as the image
+ * consumers, the frame messages are passed to them by pointer.
+ * Parameters (private):
+ *   color: first pillar's color, "r" or "b"
+ *   video: video file to replay instead of the camera, empty for camera
+ *   device: camera device, "/dev/video0"
+ *   v4l2: capture yuyv from the driver's buffers, false for VideoCapture
+ *   width, height, fps: camera mode, 640x480 at 30
+ *   exposure, gain: fixed camera settings, -1 for automatic. exposure is
+ *     in 100us units
+ *   record: file the frames are recorded to, empty for none
+ *   event_log: file of the per frame events, read by rm_event_log_decode.
+ *     The log is shared by the manager's process, when another nodelet
+ *     opened it first the events go to its file
+ */
+class CameraNodelet : public nodelet::Nodelet
+{
+public:
+  CameraNodelet() : m_running(false)
+  {
+  }
+
+  ~CameraNodelet()
+  {
+    m_running= false;
+    if(m_thread.joinable())
+      m_thread.join();
+    /*g_event_log belongs to the process, other nodelets of the manager
+     * may still log, it is written out when the process exits*/
+  }
+
+private:
+  virtual void onInit()
+  {
+    ros::NodeHandle& node= getNodeHandle();
+    ros::NodeHandle& private_node= getPrivateNodeHandle();
+
+    std::string color, video;
+    private_node.param<std::string>("color", color, "r");
+    private_node.param<std::string>("video", video, "");
+    private_node.param<std::string>("record", m_record_file, "");
+    if(color != "r" && color != "b")
+    {
+      NODELET_ERROR_STREAM("not a available color!");
+      return;
+    }
+
+    std::string device;
+    bool v4l2;
+    int width, height, exposure, gain;
+    double fps;
+    private_node.param<std::string>("device", device, "/dev/video0");
+    private_node.param("v4l2", v4l2, true);
+    private_node.param("width", width, 640);
+    private_node.param("height", height, 480);
+    private_node.param("fps", fps, 30.0);
+    private_node.param("exposure", exposure, 100);
+    private_node.param("gain", gain, -1);
+
+    if(!video.empty())
+    {
+      m_cap.open(video);
+      m_cap.set(CV_CAP_PROP_POS_FRAMES, 100);
+    }
+    else if(v4l2)
+      m_camera.open(device, width, height, fps, exposure, gain);
+    else
+      m_cap.open(0);
+    if(!m_cap.isOpened() && !m_camera.isOpened())
+    {
+      NODELET_ERROR_STREAM("camera not open");
+      return;
+    }
+    std::string event_file;
+    private_node.param<std::string>(
+        "event_log", event_file,
+        ros::file_log::getLogDirectory() + "/camera_events.bin");
+    /*the first nodelet that keeps a log opens it for the whole manager*/
+    if(g_event_log.isOpened())
+      NODELET_INFO_STREAM("event log already open, " << event_file
+                                                     << " not used");
+    else if(!g_event_log.open(event_file))
+      NODELET_WARN_STREAM("can't open event log " << event_file);
+    if(!m_record_file.empty())
+      m_recorder.open(m_record_file, CV_FOURCC('P', 'I', 'M', '1'), 30,
+                      cv::Size(640, 480));
+
+    RMChallengeVision::COLOR_TYPE first_color=
+        color == "r" ? RMChallengeVision::RED : RMChallengeVision::BLUE;
+    m_pipeline.reset(
+        new CameraPipeline(node, private_node, first_color, false));
+    /*replay the video at camera rate, restart from frame 100 at the end*/
+    if(m_camera.isOpened())
+      m_grabber.reset(new FrameGrabber(m_camera));
+    else if(video.empty())
+      m_grabber.reset(new FrameGrabber(m_cap));
+    else
+      m_grabber.reset(new FrameGrabber(m_cap, 100, 30));
+
+    /*onInit must return, the frames are processed on our own thread while
+     * the callbacks run on the manager's threads*/
+    m_running= true;
+    m_thread= std::thread(&CameraNodelet::processLoop, this);
+  }
+
+  void processLoop()
+  {
+    cv::Mat frame;
+    m_grabber->start();
+    while(m_running && ros::ok())
+    {
+      if(!m_grabber->getNewestFrame(frame, 1.0))
+        continue;
+      g_event_log.log(EV_CAMERA_FRAME, m_grabber->getDeliveredCount());
+      NODELET_INFO_STREAM_THROTTLE(
+          1.0, "frames captured: " << m_grabber->getCapturedCount()
+                                   << " processed: "
+                                   << m_grabber->getDeliveredCount()
+                                   << " dropped: "
+                                   << m_grabber->getDroppedCount()
+                                   << " failed: "
+                                   << m_grabber->getFailedCount());
+      if(m_recorder.isOpened())
+        NODELET_INFO_STREAM_THROTTLE(
+            1.0, "frames recorded: " << m_recorder.getWrittenCount()
+                                     << " backlog: "
+                                     << m_recorder.getBacklog()
+                                     << " dropped: "
+                                     << m_recorder.getDroppedCount());
+      m_pipeline->process(frame, ros::Time(m_grabber->getFrameStamp()));
+
+      /*record image to file*/
+      if(m_recorder.isOpened())
+        m_recorder.write(frame);
+    }
+    m_grabber->stop();
+    m_recorder.close();
+  }
+
+  cv::VideoCapture m_cap;
+  V4L2Capture m_camera;
+  VideoRecorder m_recorder;
+  std::string m_record_file;
+  std::unique_ptr<CameraPipeline> m_pipeline;
+  std::unique_ptr<FrameGrabber> m_grabber;
+  std::thread m_thread;
+  std::atomic<bool> m_running;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(rm_challenge::CameraNodelet, nodelet::Nodelet)
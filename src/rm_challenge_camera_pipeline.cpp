@@ -0,0 +1,167 @@
+#include "rm_challenge_camera_pipeline.h"
+
+/*pillar and line detectors run in parallel*/
+#define DETECTOR_THREAD_NUM 2
+
+CameraPipeline::CameraPipeline(ros::NodeHandle& node,
+                               ros::NodeHandle& config_node,
+                               RMChallengeVision::COLOR_TYPE color,
+                               bool visable)
+  : m_color(color)
+  , m_is_pillar_running(true)
+  , m_is_line_running(true)
+  , m_executor(DETECTOR_THREAD_NUM)
+{
+  m_pillar_pub= node.advertise<test2::PillarResult>("tpp/pillar", 1);
+  m_line_pub= node.advertise<test2::LineResult>("tpp/yellow_line", 1);
+  m_base_pub= node.advertise<test2::BaseResult>("tpp/base", 1);
+
+  m_color_change_sub= node.subscribe(
+      "/tpp/color_change", 1, &CameraPipeline::colorChangeCallback, this);
+  m_pillar_change_sub= node.subscribe(
+      "/tpp/pillar_change", 1, &CameraPipeline::pillarChangeCallback, this);
+  m_line_change_sub= node.subscribe(
+      "/tpp/line_change", 1, &CameraPipeline::lineChangeCallback, this);
+
+  m_image_pub.advertise(node, config_node, "m100/image");
+
+  m_latency.advertise(node, "tpp/latency/camera", 1.0);
+
+  m_pillar_vision.setVisability(visable);
+  m_line_vision.setVisability(visable);
+}
+
+void CameraPipeline::process(const cv::Mat& frame, const ros::Time& stamp)
+{
+  /* publish this frame to ROS topic if anyone listens, the image and the
+   * results of this frame carry its capture stamp*/
+  m_latency.record("dequeue", stamp);
+  m_image_pub.publish(frame, stamp);
+
+  /*run the detectors of this frame in parallel*/
+  m_frame_context.reset(frame);
+  bool is_pillar_running= m_is_pillar_running;
+  bool is_line_running= m_is_line_running;
+  RMChallengeVision::COLOR_TYPE pillar_color=
+      (RMChallengeVision::COLOR_TYPE)m_color.load();
+  RMChallengeVision::PILLAR_RESULT pillar_result;
+  float distance_x, distance_y, line_vector_x, line_vector_y;
+  bool is_T_found= false;
+  m_executor.clear();
+  if(is_pillar_running)
+  {
+    m_executor.addTask("pillar", [&]() {
+      m_latency.record("pillar_start", stamp);
+      m_pillar_vision.detectPillar(m_frame_context, pillar_color,
+                                   pillar_result);
+      m_latency.record("pillar_end", stamp);
+    });
+  }
+  if(is_line_running)
+  {
+    m_executor.addTask("line", [&]() {
+      m_latency.record("line_start", stamp);
+      is_T_found= m_line_vision.detectLineWithT(m_frame_context, distance_x,
+                                                distance_y, line_vector_x,
+                                                line_vector_y);
+      m_latency.record("line_end", stamp);
+    });
+  }
+  m_executor.run();
+  ROS_INFO_STREAM_THROTTLE(1.0, "detector time: "
+                                    << m_executor.timingString());
+
+  if(is_pillar_running)
+    publishPillar(stamp, pillar_color, pillar_result);
+  if(is_line_running)
+    publishLine(stamp, is_T_found, distance_x, distance_y, line_vector_x,
+                line_vector_y);
+  m_latency.record("publish", stamp);
+  ROS_INFO_STREAM_THROTTLE(1.0, "latency p50/p95/p99: "
+                                    << m_latency.reportString());
+}
+
+void CameraPipeline::publishPillar(
+    const ros::Time& stamp, RMChallengeVision::COLOR_TYPE pillar_color,
+    RMChallengeVision::PILLAR_RESULT& pillar_result)
+{
+  test2::PillarResultPtr pillar_msg(new test2::PillarResult);
+  pillar_msg->header.stamp= stamp;
+  for(int i= 0; i < 4; i++)
+    pillar_msg->triangle[i]= pillar_result.triangle[i];
+  pillar_msg->circle_found= pillar_result.circle_found;
+  pillar_msg->circle_x= pillar_msg->circle_y= pillar_msg->height= 0;
+  pillar_msg->arc_found= pillar_result.arc_found;
+  pillar_msg->arc_x= pillar_msg->arc_y= 1;
+  if(pillar_result.circle_found)
+  {
+    // calculate height and pos_error
+    pillar_msg->height=
+        m_pillar_vision.imageToHeight(pillar_result.radius, 250.0);
+    pillar_msg->circle_x= m_pillar_vision.imageToRealDistance(
+        pillar_result.radius, pillar_result.circle_center.x, 250.0);
+    pillar_msg->circle_y= m_pillar_vision.imageToRealDistance(
+        pillar_result.radius, pillar_result.circle_center.y, 250.0);
+  }
+  if(pillar_result.arc_found)
+  {
+    /*send image pixel error to uav*/
+    pillar_msg->arc_x= pillar_result.arc_center.x;
+    pillar_msg->arc_y= pillar_result.arc_center.y;
+  }
+  g_event_log.log(EV_PILLAR_RESULT, pillar_color, pillar_msg->circle_found,
+                  pillar_msg->circle_x, pillar_msg->circle_y,
+                  pillar_msg->height);
+  // publish result to uav
+  m_pillar_pub.publish(pillar_msg);
+}
+
+void CameraPipeline::publishLine(const ros::Time& stamp, bool is_T_found,
+                                 float distance_x, float distance_y,
+                                 float line_vector_x, float line_vector_y)
+{
+  g_event_log.log(EV_LINE_RESULT, is_T_found, distance_x, distance_y,
+                  line_vector_x, line_vector_y);
+  // publish result
+  test2::LineResultPtr line_msg(new test2::LineResult);
+  line_msg->header.stamp= stamp;
+  line_msg->T_found= is_T_found;
+  line_msg->distance_x= distance_x;
+  line_msg->distance_y= distance_y;
+  line_msg->direction_x= line_vector_x;
+  line_msg->direction_y= line_vector_y;
+  m_line_pub.publish(line_msg);
+}
+
+void CameraPipeline::colorChangeCallback(
+    const std_msgs::String::ConstPtr& msg)
+{
+  ROS_INFO_STREAM("receive color change info");
+  if(msg->data == "red")
+    m_color= RMChallengeVision::RED;
+  else if(msg->data == "blue")
+    m_color= RMChallengeVision::BLUE;
+}
+
+void CameraPipeline::pillarChangeCallback(
+    const std_msgs::String::ConstPtr& msg)
+{
+  ROS_INFO_STREAM("receive pillar change info");
+  if(msg->data == "pause")
+    m_is_pillar_running= false;
+  else if(msg->data == "resume")
+    m_is_pillar_running= true;
+  else
+    ROS_INFO_STREAM("invalid state");
+}
+
+void CameraPipeline::lineChangeCallback(const std_msgs::String::ConstPtr& msg)
+{
+  ROS_INFO_STREAM("receive line change info");
+  if(msg->data == "pause")
+    m_is_line_running= false;
+  else if(msg->data == "resume")
+    m_is_line_running= true;
+  else
+    ROS_INFO_STREAM("invalid state");
+}
@@ -0,0 +1,198 @@
+#include "rm_challenge_event_log.h"
+
+#include <string.h>
+#include <chrono>
+
+EventLog g_event_log;
+
+static const EVENT_INFO g_event_info[EV_COUNT]= {
+  { "log_dropped", "count", { NULL, NULL, NULL, NULL } },
+  { "fsm_tick", "state", { "height", "x", "y", NULL } },
+  { "uav_state", "state", { NULL, NULL, NULL, NULL } },
+  { "guidance_height", NULL, { "height", NULL, NULL, NULL } },
+  { "guidance_position", "uav_state", { "x", "y", "bias_x", "bias_y" } },
+  { "camera_frame", "frame", { NULL, NULL, NULL, NULL } },
+  { "pillar_stage", "stage", { NULL, NULL, NULL, NULL } },
+  { "pillar_circle", "found", { "x", "y", "radius", NULL } },
+  { "pillar_result", "color", { "circle_found", "circle_x", "circle_y",
+                                "height" } },
+  { "line_result", "T_found", { "distance_x", "distance_y", "direction_x",
+                                "direction_y" } },
+  { "bomber_move", "can_bomb", { "vx", "vy", "base_found", NULL } },
+  { "fsm_state", "state", { "seconds", "ticks", "tick_ms_mean",
+                            "tick_ms_max" } },
+};
+
+static const EVENT_INFO g_unknown_event= { "unknown", "value",
+                                           { "d0", "d1", "d2", "d3" } };
+
+static uint64_t nowNs()
+{
+  return chrono::duration_cast<chrono::nanoseconds>(
+             chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+EventLog::EventLog(int ring_size, double flush_period)
+  : m_ring_size(1)
+  , m_flush_period(flush_period)
+  , m_open(false)
+  , m_file(NULL)
+  , m_stop(false)
+{
+  while((int)m_ring_size < ring_size)
+    m_ring_size<<= 1;
+}
+
+EventLog::~EventLog()
+{
+  close();
+}
+
+bool EventLog::open(const string& file_name)
+{
+  close();
+  m_file= fopen(file_name.c_str(), "wb");
+  if(m_file == NULL)
+    return false;
+  EVENT_FILE_HEADER header;
+  memcpy(header.magic, "RMEV", 4);
+  header.version= 1;
+  header.record_size= sizeof(EVENT_RECORD);
+  header.reserved= 0;
+  fwrite(&header, sizeof(header), 1, m_file);
+  m_stop= false;
+  m_thread= thread(&EventLog::flushLoop, this);
+  m_open= true;
+  return true;
+}
+
+void EventLog::close()
+{
+  m_open= false;
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_stop= true;
+  }
+  m_cv.notify_all();
+  if(m_thread.joinable())
+    m_thread.join();
+  if(m_file != NULL)
+  {
+    fclose(m_file);
+    m_file= NULL;
+  }
+}
+
+bool EventLog::isOpened() const
+{
+  return m_open;
+}
+
+void EventLog::log(EVENT_ID id, int value, float d0, float d1, float d2,
+                   float d3)
+{
+  if(!m_open.load(memory_order_relaxed))
+    return;
+  RING* ring= threadRing();
+  uint32_t head= ring->head.load(memory_order_relaxed);
+  if(head - ring->tail.load(memory_order_acquire) >= m_ring_size)
+  {
+    ring->dropped.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+  EVENT_RECORD& record= ring->records[head & (m_ring_size - 1)];
+  record.stamp_ns= nowNs();
+  record.id= id;
+  record.thread= ring->thread;
+  record.value= value;
+  record.data[0]= d0;
+  record.data[1]= d1;
+  record.data[2]= d2;
+  record.data[3]= d3;
+  /*the flushing thread reads the record only after head is published*/
+  ring->head.store(head + 1, memory_order_release);
+}
+
+const EVENT_INFO& EventLog::info(int id)
+{
+  if(id < 0 || id >= EV_COUNT)
+    return g_unknown_event;
+  return g_event_info[id];
+}
+
+EventLog::RING* EventLog::threadRing()
+{
+  static thread_local EventLog* owner= NULL;
+  static thread_local RING* ring= NULL;
+  if(owner == this)
+    return ring;
+  /*first event of this thread, only here the rings are locked*/
+  lock_guard<mutex> lock(m_rings_mutex);
+  RING* r= new RING;
+  r->records.resize(m_ring_size);
+  r->head= 0;
+  r->tail= 0;
+  r->dropped= 0;
+  r->reported_dropped= 0;
+  r->thread= m_rings.size();
+  m_rings.push_back(unique_ptr<RING>(r));
+  owner= this;
+  ring= r;
+  return ring;
+}
+
+void EventLog::flushLoop()
+{
+  unique_lock<mutex> lock(m_mutex);
+  while(true)
+  {
+    m_cv.wait_for(lock, chrono::duration<double>(m_flush_period),
+                  [this] { return m_stop; });
+    bool stop= m_stop;
+    lock.unlock();
+    vector<RING*> rings;
+    {
+      lock_guard<mutex> rings_lock(m_rings_mutex);
+      for(int i= 0; i < (int)m_rings.size(); i++)
+        rings.push_back(m_rings[i].get());
+    }
+    for(int i= 0; i < (int)rings.size(); i++)
+      flushRing(*rings[i]);
+    fflush(m_file);
+    /*the events logged before close are still written*/
+    if(stop)
+      return;
+    lock.lock();
+  }
+}
+
+void EventLog::flushRing(RING& ring)
+{
+  uint32_t tail= ring.tail.load(memory_order_relaxed);
+  uint32_t head= ring.head.load(memory_order_acquire);
+  while(tail != head)
+  {
+    /*at most two chunks, before and after the end of the ring*/
+    uint32_t start= tail & (m_ring_size - 1);
+    uint32_t n= head - tail;
+    if(n > m_ring_size - start)
+      n= m_ring_size - start;
+    fwrite(&ring.records[start], sizeof(EVENT_RECORD), n, m_file);
+    tail+= n;
+  }
+  ring.tail.store(tail, memory_order_release);
+
+  uint32_t dropped= ring.dropped.load(memory_order_relaxed);
+  if(dropped != ring.reported_dropped)
+  {
+    EVENT_RECORD record;
+    memset(&record, 0, sizeof(record));
+    record.stamp_ns= nowNs();
+    record.id= EV_LOG_DROPPED;
+    record.thread= ring.thread;
+    record.value= dropped - ring.reported_dropped;
+    fwrite(&record, sizeof(record), 1, m_file);
+    ring.reported_dropped= dropped;
+  }
+}
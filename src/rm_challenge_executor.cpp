@@ -0,0 +1,143 @@
+#include "rm_challenge_executor.h"
+
+#include <chrono>
+#include <sstream>
+
+/*weight of the last frame in the moving average*/
+#define EXECUTOR_AVERAGE_WEIGHT 0.1
+
+static double elapsedMs(const chrono::steady_clock::time_point& start)
+{
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start)
+      .count();
+}
+
+DetectorExecutor::DetectorExecutor(int thread_num)
+  : m_unfinished(0), m_stop(false), m_frame_ms(0)
+{
+  for(int i= 0; i < thread_num; i++)
+    m_threads.push_back(thread(&DetectorExecutor::workerLoop, this));
+}
+
+DetectorExecutor::~DetectorExecutor()
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_stop= true;
+  }
+  m_task_cv.notify_all();
+  for(int i= 0; i < (int)m_threads.size(); i++)
+    m_threads[i].join();
+}
+
+void DetectorExecutor::clear()
+{
+  m_tasks.clear();
+}
+
+int DetectorExecutor::addTask(const string& name, const function<void()>& work,
+                              const vector<int>& after)
+{
+  TASK task;
+  task.name= name;
+  task.work= work;
+  task.waiting= (int)after.size();
+  task.ms= 0;
+  int id= (int)m_tasks.size();
+  m_tasks.push_back(task);
+  for(int i= 0; i < (int)after.size(); i++)
+    m_tasks[after[i]].next.push_back(id);
+  return id;
+}
+
+void DetectorExecutor::run()
+{
+  chrono::steady_clock::time_point start= chrono::steady_clock::now();
+  {
+    unique_lock<mutex> lock(m_mutex);
+    m_unfinished= (int)m_tasks.size();
+    m_ready.clear();
+    for(int i= 0; i < (int)m_tasks.size(); i++)
+      if(m_tasks[i].waiting == 0)
+        m_ready.push_back(i);
+    m_task_cv.notify_all();
+    m_done_cv.wait(lock, [this] { return m_unfinished == 0; });
+  }
+  m_frame_ms= elapsedMs(start);
+
+  /*keep the timings by task name, tasks may differ between frames*/
+  for(int i= 0; i < (int)m_tasks.size(); i++)
+  {
+    int k= 0;
+    while(k < (int)m_timings.size() && m_timings[k].name != m_tasks[i].name)
+      k++;
+    if(k == (int)m_timings.size())
+    {
+      TASK_TIMING timing= { m_tasks[i].name, m_tasks[i].ms, m_tasks[i].ms };
+      m_timings.push_back(timing);
+      continue;
+    }
+    m_timings[k].last_ms= m_tasks[i].ms;
+    m_timings[k].average_ms+= EXECUTOR_AVERAGE_WEIGHT *
+                              (m_tasks[i].ms - m_timings[k].average_ms);
+  }
+}
+
+void DetectorExecutor::workerLoop()
+{
+  unique_lock<mutex> lock(m_mutex);
+  while(true)
+  {
+    m_task_cv.wait(lock, [this] { return m_stop || !m_ready.empty(); });
+    if(m_stop)
+      return;
+    int id= m_ready.back();
+    m_ready.pop_back();
+    /*m_tasks is not resized while run() waits, the task can be used
+     * without the lock*/
+    TASK& task= m_tasks[id];
+    lock.unlock();
+    chrono::steady_clock::time_point start= chrono::steady_clock::now();
+    task.work();
+    task.ms= elapsedMs(start);
+    lock.lock();
+    finishTask(id);
+  }
+}
+
+void DetectorExecutor::finishTask(int id)
+{
+  TASK& task= m_tasks[id];
+  for(int i= 0; i < (int)task.next.size(); i++)
+  {
+    if(--m_tasks[task.next[i]].waiting == 0)
+    {
+      m_ready.push_back(task.next[i]);
+      m_task_cv.notify_one();
+    }
+  }
+  if(--m_unfinished == 0)
+    m_done_cv.notify_all();
+}
+
+double DetectorExecutor::getFrameTime() const
+{
+  return m_frame_ms;
+}
+
+const vector<DetectorExecutor::TASK_TIMING>&
+DetectorExecutor::getTimings() const
+{
+  return m_timings;
+}
+
+string DetectorExecutor::timingString() const
+{
+  stringstream ss;
+  ss.precision(3);
+  ss << "frame " << m_frame_ms << "ms";
+  for(int i= 0; i < (int)m_timings.size(); i++)
+    ss << ", " << m_timings[i].name << " " << m_timings[i].last_ms << "ms(avg "
+       << m_timings[i].average_ms << ")";
+  return ss.str();
+}
@@ -0,0 +1,95 @@
+#include "rm_challenge_frame_context.h"
+
+FrameContext::FrameContext(const Mat& frame) : m_is_yuyv(false)
+{
+  reset(frame);
+}
+
+void FrameContext::reset(const Mat& frame)
+{
+  bool was_yuyv= m_is_yuyv;
+  m_is_yuyv= frame.type() == CV_8UC2;
+  if(m_is_yuyv)
+  {
+    /*m_bgr is converted into, it must not share the last bgr frame*/
+    if(!was_yuyv)
+      m_bgr.release();
+    m_yuyv= frame;
+  }
+  else
+  {
+    m_bgr= frame;
+    m_yuyv.release();
+  }
+  /*only mark as stale, the buffers are reused for the next frame*/
+  m_has_bgr= !m_is_yuyv;
+  m_has_blurred= false;
+  m_has_gray= false;
+  m_has_gray_blurred= false;
+  m_masks.clear();
+}
+
+const Mat& FrameContext::bgr()
+{
+  lock_guard<mutex> lock(m_bgr_mutex);
+  if(!m_has_bgr)
+  {
+    cvtColor(m_yuyv, m_bgr, CV_YUV2BGR_YUY2);
+    m_has_bgr= true;
+  }
+  return m_bgr;
+}
+
+const Mat& FrameContext::blurred()
+{
+  lock_guard<mutex> lock(m_blurred_mutex);
+  if(!m_has_blurred)
+  {
+    GaussianBlur(bgr(), m_blurred, Size(5, 5), 0, 0);
+    m_has_blurred= true;
+  }
+  return m_blurred;
+}
+
+const Mat& FrameContext::gray()
+{
+  lock_guard<mutex> lock(m_gray_mutex);
+  if(!m_has_gray)
+  {
+    if(m_is_yuyv)
+      cvtColor(m_yuyv, m_gray, CV_YUV2GRAY_YUY2);
+    else if(m_bgr.channels() == 3)
+      cvtColor(m_bgr, m_gray, CV_BGR2GRAY);
+    else
+      m_bgr.copyTo(m_gray);
+    m_has_gray= true;
+  }
+  return m_gray;
+}
+
+const Mat& FrameContext::grayBlurred()
+{
+  lock_guard<mutex> lock(m_gray_blurred_mutex);
+  if(!m_has_gray_blurred)
+  {
+    blur(gray(), m_gray_blurred, Size(3, 3));
+    m_has_gray_blurred= true;
+  }
+  return m_gray_blurred;
+}
+
+bool FrameContext::findMask(const string& key, Mat& mask) const
+{
+  lock_guard<mutex> lock(m_masks_mutex);
+  map<string, Mat>::const_iterator it= m_masks.find(key);
+  if(it == m_masks.end())
+    return false;
+  mask= it->second;
+  return true;
+}
+
+void FrameContext::storeMask(const string& key, const Mat& mask)
+{
+  lock_guard<mutex> lock(m_masks_mutex);
+  m_masks[key]= mask;
+}
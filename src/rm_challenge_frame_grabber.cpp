@@ -0,0 +1,181 @@
+#include "rm_challenge_frame_grabber.h"
+
+#include <chrono>
+
+FrameGrabber::FrameGrabber(cv::VideoCapture& cap, int rewind_frame,
+                           double max_fps)
+  : m_cap(&cap)
+  , m_v4l2(NULL)
+  , m_rewind_frame(rewind_frame)
+  , m_max_fps(max_fps)
+  , m_back(0)
+  , m_middle(1)
+  , m_front(2)
+  , m_running(false)
+  , m_captured(0)
+  , m_delivered(0)
+  , m_dropped(0)
+  , m_failed(0)
+{
+  m_stamps[0]= m_stamps[1]= m_stamps[2]= 0;
+  m_buffers[0]= m_buffers[1]= m_buffers[2]= -1;
+}
+
+FrameGrabber::FrameGrabber(V4L2Capture& capture)
+  : m_cap(NULL)
+  , m_v4l2(&capture)
+  , m_rewind_frame(-1)
+  , m_max_fps(0)
+  , m_back(0)
+  , m_middle(1)
+  , m_front(2)
+  , m_running(false)
+  , m_captured(0)
+  , m_delivered(0)
+  , m_dropped(0)
+  , m_failed(0)
+{
+  m_stamps[0]= m_stamps[1]= m_stamps[2]= 0;
+  m_buffers[0]= m_buffers[1]= m_buffers[2]= -1;
+}
+
+FrameGrabber::~FrameGrabber()
+{
+  stop();
+}
+
+void FrameGrabber::start()
+{
+  if(m_running)
+    return;
+  m_running= true;
+  m_thread= thread(&FrameGrabber::captureLoop, this);
+}
+
+void FrameGrabber::stop()
+{
+  m_running= false;
+  notifyFrame();
+  if(m_thread.joinable())
+    m_thread.join();
+}
+
+void FrameGrabber::notifyFrame()
+{
+  /*a waiter checks its condition under the lock, taking it here keeps the
+   * notify from falling between its check and its wait*/
+  {
+    lock_guard<mutex> lock(m_frame_mutex);
+  }
+  m_frame_cv.notify_one();
+}
+
+void FrameGrabber::captureLoop()
+{
+  chrono::steady_clock::duration period=
+      chrono::steady_clock::duration::zero();
+  if(m_max_fps > 0)
+    period= chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(1.0 / m_max_fps));
+  chrono::steady_clock::time_point next= chrono::steady_clock::now();
+  while(m_running)
+  {
+    if(!readFrame(m_back))
+    {
+      m_failed++;
+      /*the camera keeps streaming after a timeout, back off on errors*/
+      if(m_v4l2 != NULL)
+      {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        continue;
+      }
+      if(m_rewind_frame < 0)
+        break;
+      m_cap->set(CV_CAP_PROP_POS_FRAMES, m_rewind_frame);
+      continue;
+    }
+    m_captured++;
+    /*publish the new frame, take back the old middle slot*/
+    int old= m_middle.exchange(m_back | FRESH);
+    if(old & FRESH)
+      m_dropped++;
+    m_back= old & SLOT_MASK;
+    notifyFrame();
+
+    if(m_max_fps > 0)
+    {
+      next+= period;
+      this_thread::sleep_until(next);
+    }
+  }
+  m_running= false;
+  notifyFrame();
+}
+
+bool FrameGrabber::readFrame(int slot)
+{
+  if(m_v4l2 != NULL)
+  {
+    /*nobody uses the frame of the slot any more, the driver may refill
+     * its buffer*/
+    if(m_buffers[slot] >= 0)
+      m_v4l2->release(m_buffers[slot]);
+    m_buffers[slot]= -1;
+    return m_v4l2->dequeue(m_buffers[slot], m_slots[slot], m_stamps[slot],
+                           1.0);
+  }
+  /*read into the preallocated buffer, same size frames reuse it*/
+  if(!m_cap->read(m_slots[slot]) || m_slots[slot].empty())
+    return false;
+  m_stamps[slot]= chrono::duration<double>(
+                      chrono::system_clock::now().time_since_epoch())
+                      .count();
+  return true;
+}
+
+bool FrameGrabber::getNewestFrame(cv::Mat& frame, double timeout)
+{
+  chrono::steady_clock::time_point deadline=
+      chrono::steady_clock::now() +
+      chrono::duration_cast<chrono::steady_clock::duration>(
+          chrono::duration<double>(timeout));
+  {
+    unique_lock<mutex> lock(m_frame_mutex);
+    if(!m_frame_cv.wait_until(lock, deadline, [this]() {
+         return (m_middle.load() & FRESH) || !m_running;
+       }))
+      return false;
+  }
+  if(!(m_middle.load() & FRESH))
+    return false;
+  /*hand our slot back and take the newest one*/
+  m_front= m_middle.exchange(m_front) & SLOT_MASK;
+  m_delivered++;
+  frame= m_slots[m_front];
+  return true;
+}
+
+double FrameGrabber::getFrameStamp() const
+{
+  return m_stamps[m_front];
+}
+
+unsigned long FrameGrabber::getCapturedCount() const
+{
+  return m_captured;
+}
+
+unsigned long FrameGrabber::getDeliveredCount() const
+{
+  return m_delivered;
+}
+
+unsigned long FrameGrabber::getDroppedCount() const
+{
+  return m_dropped;
+}
+
+unsigned long FrameGrabber::getFailedCount() const
+{
+  return m_failed;
+}
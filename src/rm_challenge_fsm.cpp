@@ -2,7 +2,7 @@
 
 RMChallengeFSM::~RMChallengeFSM()
 {
-  delete m_serial_port;
+  m_serial.close();
 #if CURRENT_COMPUTER == MANIFOLD
   m_drone->release_sdk_permission_control();
   delete m_drone;
@@ -12,16 +12,7 @@ RMChallengeFSM::~RMChallengeFSM()
 void RMChallengeFSM::initialize(ros::NodeHandle &node_handle)
 {
   /*initialize serial port*/
-  m_serial_port= new boost::asio::serial_port(m_io_service);
-  m_serial_port->open("/dev/ttyTHS0", m_err_code);
-  m_serial_port->set_option(serial_port::baud_rate(9600), m_err_code);
-  m_serial_port->set_option(
-      serial_port::flow_control(serial_port::flow_control::none), m_err_code);
-  m_serial_port->set_option(serial_port::parity(serial_port::parity::none),
-                            m_err_code);
-  m_serial_port->set_option(serial_port::stop_bits(serial_port::stop_bits::one),
-                            m_err_code);
-  m_serial_port->set_option(serial_port::character_size(8), m_err_code);
+  m_serial.open("/dev/ttyTHS0", 9600);
 
 /*initialize dji sdk*/
 #if CURRENT_COMPUTER == MANIFOLD
@@ -41,6 +32,7 @@ void RMChallengeFSM::initialize(ros::NodeHandle &node_handle)
       node_handle.advertise<std_msgs::String>("/tpp/line_change", 1);
   m_base_change_pub=
       node_handle.advertise<std_msgs::String>("/tpp/base_change", 1);
+  m_latency.advertise(node_handle, "tpp/latency/uav", 1.0);
 
   /*initialize setpoint, takeoffpoint and takeoff height,
    only set for one time, takeoff positions are absolute position,
@@ -140,13 +132,21 @@ void RMChallengeFSM::initialize(ros::NodeHandle &node_handle)
   m_goal_height[PA_PILLAR_Q]= PA_TAKEOFF_HEIGHT - PA_PILLAR_HEIGHT;
 
   /*initialize  state*/
+  indexTransitions();
   resetAllState();
 }
 
 void RMChallengeFSM::resetAllState()
 {
-  ros::Duration(1.0).sleep();
+  /*called on every tick out of F mode, reset and ask for control only
+   * once per PA_RESET_TIME*/
+  ros::Time now= ros::Time::now();
+  if(now < m_next_reset_time)
+    return;
+  m_next_reset_time= now + ros::Duration(PA_RESET_TIME);
+  /*not a transition, the visit that ends is not reported*/
   m_state= TAKE_OFF;
+  beginStateVisit();
   m_uav_state= UAV_LAND;
   m_prepare_to_land_type= PREPARE_AT_HIGH;
   m_base_state= BASE_POSITION;
@@ -156,7 +156,10 @@ void RMChallengeFSM::resetAllState()
   m_already_find_T= false;
   for(int i= 0; i < 4; i++)
     m_pillar_triangle[i]= 0;
-  m_discover_pillar_circle= false;
+  m_estimator.resetVision();
+  m_printed_state= -1;
+  m_action_step= 0;
+  m_action_deadline= ros::Time(0);
 
   /**/
   droneUpdatePosition();
@@ -167,396 +170,302 @@ void RMChallengeFSM::resetAllState()
 #endif
 }
 
+/*transition table shorthands*/
+#define IF(condition) (1u << (condition))
+#define DO(action) (&RMChallengeFSM::action)
+
+/*in the order of CONDITION*/
+bool (RMChallengeFSM::*const RMChallengeFSM::s_conditions[CONDITION_NUM])()=
+    {
+      DO(isWaiting),
+      DO(isTakingoff),
+      DO(isTakeoffTimeout),
+      DO(takeoffFromStart),
+      DO(isOnLand),
+      DO(closeToGoalHeight),
+      DO(farFromTakeoffPoint),
+      DO(discoverLandPoint),
+      DO(stillFindLandPoint),
+      DO(discoverYellowLine),
+      DO(discoverT),
+      DO(nextTargetIsClosePillar),
+      DO(nextTargetIsFarPillar),
+      DO(nextTargetIsBase),
+      DO(closeToSetPoint),
+      DO(readyToLand),
+      DO(landPointIsPillar),
+      DO(landPointIsBase),
+      DO(isQulifying),
+      DO(isTheLastTravel),
+      DO(finishGrabBallTask),
+      DO(lowEnoughToReleaseBall),
+      DO(forwardFarEnough),
+      DO(backwardFarEnough),
+    };
+
+/*in the order of TASK_STATE*/
+const RMChallengeFSM::STATE_INFO RMChallengeFSM::s_state_info[STATE_NUM]= {
+  { "TAKE OFF", "take_off", NULL },
+  { "GO UP", "go_up", NULL },
+  /*do no vision task when go to set point, only judge if close to
+  set point, when close, either go to track line or idle*/
+  { "GO TO SETPOINT", "go_to_setpoint", DO(updateVisionTaskAndColor) },
+  { "IDLE", "idle", NULL },
+  { "TRACK LINE", "track_line", NULL },
+  { "LAND", "land", NULL },
+  { "GRAB BALL", "grab_ball", NULL },
+  { "GO TO LANDPOINT", "go_to_land_point", NULL },
+  { "GO TO PILLAR", "go_to_pillar", DO(droneGoToPillar) },
+  { "RELEASE BALL", "release_ball", NULL },
+  { "CROSS ARENA", "cross_arena", NULL },
+  { "TRACK LINE FORWARD", "track_line_forward", NULL },
+  { "TRACK LINE BACKWARD", "track_line_backward", NULL },
+  { "FINAL", "final", NULL },
+};
+
+/*rows of a state stay together, a condition already known false in an
+earlier row of the state is not repeated in the later ones*/
+const RMChallengeFSM::TRANSITION RMChallengeFSM::s_transitions[]= {
+  /*send take off command to uav until state change, again after the
+  retry time*/
+  { TAKE_OFF, 0, 0, IF(C_TAKING_OFF) | IF(C_WAITING), DO(startTakeoff),
+    TAKE_OFF },
+  { TAKE_OFF, 0, IF(C_TAKING_OFF) | IF(C_TAKEOFF_TIMEOUT) | IF(C_FROM_START),
+    0, NULL, GO_TO_SETPOINT },
+  { TAKE_OFF, 0, IF(C_TAKING_OFF) | IF(C_TAKEOFF_TIMEOUT), 0, NULL, GO_UP },
+
+  { GO_UP, 0, 0, IF(C_GOAL_HEIGHT), DO(droneGoUp), GO_UP },
+  { GO_UP, 0, 0, 0, NULL, GO_TO_SETPOINT },
+
+  { GO_TO_SETPOINT, 0, 0, IF(C_FAR_FROM_TAKEOFF), DO(droneGoToSetPoint),
+    GO_TO_SETPOINT },
+  { GO_TO_SETPOINT, 0, IF(C_YELLOW_LINE), 0, NULL, TRACK_LINE },
+  { GO_TO_SETPOINT, 0, 0, IF(C_LAND_POINT) | IF(C_SETPOINT),
+    DO(droneGoToSetPoint), GO_TO_SETPOINT },
+  { GO_TO_SETPOINT, 0, 0, 0, NULL, IDLE },
+
+  { TRACK_LINE, 0, IF(C_LAND_POINT), 0, NULL, GO_TO_LAND_POINT },
+  { TRACK_LINE, 0, IF(C_YELLOW_LINE) | IF(C_T) | IF(C_NEXT_CLOSE_PILLAR), 0,
+    DO(droneTrackLine), GO_TO_PILLAR },
+  /*go forward for a while*/
+  { TRACK_LINE, 0, IF(C_YELLOW_LINE) | IF(C_T) | IF(C_NEXT_FAR_PILLAR), 0,
+    DO(trackLineFromT), TRACK_LINE_FORWARD },
+  { TRACK_LINE, 0, IF(C_YELLOW_LINE) | IF(C_T) | IF(C_NEXT_BASE), 0,
+    DO(trackLineFromT), TRACK_LINE_BACKWARD },
+  { TRACK_LINE, 0, IF(C_YELLOW_LINE), 0, DO(droneTrackLine), TRACK_LINE },
+  { TRACK_LINE, 0, 0, IF(C_SETPOINT), NULL, GO_TO_SETPOINT },
+  { TRACK_LINE, 0, 0, 0, NULL, IDLE },
+
+  /*step 1 is dropping onto the pillar*/
+  { GO_TO_LAND_POINT, 1, 0, IF(C_WAITING), DO(droneDropDown), LAND },
+  { GO_TO_LAND_POINT, 1, 0, 0, DO(droneDropDown), GO_TO_LAND_POINT },
+  { GO_TO_LAND_POINT, 0, IF(C_STILL_LAND_POINT), IF(C_READY_TO_LAND),
+    DO(dronePrepareToLand), GO_TO_LAND_POINT },
+  { GO_TO_LAND_POINT, 0,
+    IF(C_STILL_LAND_POINT) | IF(C_READY_TO_LAND) | IF(C_PILLAR_LAND_POINT), 0,
+    DO(startDropDown), GO_TO_LAND_POINT },
+  { GO_TO_LAND_POINT, 0, IF(C_STILL_LAND_POINT) | IF(C_READY_TO_LAND) |
+                             IF(C_BASE_LAND_POINT) | IF(C_QULIFYING),
+    0, DO(leaveBase), GO_UP },
+  { GO_TO_LAND_POINT, 0,
+    IF(C_STILL_LAND_POINT) | IF(C_READY_TO_LAND) | IF(C_BASE_LAND_POINT),
+    IF(C_LAST_TRAVEL), DO(droneHover), RELEASE_BALL },
+  { GO_TO_LAND_POINT, 0,
+    IF(C_STILL_LAND_POINT) | IF(C_READY_TO_LAND) | IF(C_BASE_LAND_POINT), 0,
+    DO(droneHover), FINAL },
+  { GO_TO_LAND_POINT, 0, IF(C_STILL_LAND_POINT), 0, NULL, GO_TO_LAND_POINT },
+  { GO_TO_LAND_POINT, 0, 0, IF(C_SETPOINT), NULL, GO_TO_SETPOINT },
+  { GO_TO_LAND_POINT, 0, 0, 0, NULL, IDLE },
+
+  { LAND, 0, 0, IF(C_ON_LAND), DO(landWithGraspperOpen), LAND },
+  { LAND, 0, 0, 0, NULL, GRAB_BALL },
+
+  /*graspper is moving*/
+  { GRAB_BALL, 0, IF(C_WAITING), 0, NULL, GRAB_BALL },
+  { GRAB_BALL, 0, 0, IF(C_GRAB_FINISHED), DO(startGrabBall), GRAB_BALL },
+  { GRAB_BALL, 0, 0, 0, DO(finishGrabBall), TAKE_OFF },
+
+  { IDLE, 0, IF(C_LAND_POINT), 0, NULL, GO_TO_LAND_POINT },
+  { IDLE, 0, IF(C_YELLOW_LINE), 0, NULL, TRACK_LINE },
+  { IDLE, 0, 0, 0, DO(droneHover), IDLE },
+
+  /*go down to lower height, open the graspper, close it again and
+  wait for the ball to fall before going up*/
+  { RELEASE_BALL, 1, IF(C_WAITING), 0, DO(droneHover), RELEASE_BALL },
+  { RELEASE_BALL, 1, 0, 0, DO(finishReleaseBall), RELEASE_BALL },
+  { RELEASE_BALL, 2, IF(C_WAITING), 0, DO(droneHover), RELEASE_BALL },
+  { RELEASE_BALL, 2, 0, 0, DO(droneHover), GO_UP },
+  { RELEASE_BALL, 0, IF(C_RELEASE_HEIGHT), 0, DO(startReleaseBall),
+    RELEASE_BALL },
+  { RELEASE_BALL, 0, 0, 0, DO(droneGoDownToBase), RELEASE_BALL },
+
+  { GO_TO_PILLAR, 0, IF(C_LAND_POINT), 0, NULL, GO_TO_LAND_POINT },
+
+  { TRACK_LINE_FORWARD, 0, 0, IF(C_FORWARD_ENOUGH), DO(droneGoForward),
+    TRACK_LINE_FORWARD },
+  { TRACK_LINE_FORWARD, 0, 0, 0, NULL, TRACK_LINE },
+
+  { TRACK_LINE_BACKWARD, 0, 0, IF(C_BACKWARD_ENOUGH), DO(droneGoBackward),
+    TRACK_LINE_BACKWARD },
+  { TRACK_LINE_BACKWARD, 0, 0, 0, NULL, TRACK_LINE },
+
+  { FINAL, 0, 0, IF(C_ON_LAND), DO(droneLand), FINAL },
+  { FINAL, 0, IF(C_ON_LAND), IF(C_WAITING), DO(openFinalGraspper), FINAL },
+};
+
+#undef IF
+#undef DO
+
+const int RMChallengeFSM::s_transition_num=
+    sizeof(s_transitions) / sizeof(s_transitions[0]);
+
 void RMChallengeFSM::run()
 {
+  /*no state action blocks, the tick time is published as fsm_tick and
+  as tick_<state>*/
+  ros::WallTime tick_start= ros::WallTime::now();
+  applyInputs();
+  m_latency.record("fsm_run", m_vision_stamp);
   printStateInfo();
   publishPosition();
-  switch(m_state)
-  {
-    case TAKE_OFF:
-    {
-      // send take off command to uav until state change
-      if(!isTakingoff())
-      {
-        /* send take off command to uav*/
-        closeGraspper();
-        droneTakeoff();
-        updateTakeoffTime();
-        ros::Duration(1.0).sleep();
-      }
-      else
-      {
-        if(isTakingoff() && !isTakeoffTimeout())
-        {
-          /* wait for time out */
-          ros::Duration(0.5).sleep();
-        }
-        else if(isTakeoffTimeout())
-        {
-          if(m_current_takeoff_point_id==PA_START||
-                m_current_takeoff_point_id==PA_START_Q)
-             transferToTask(GO_TO_SETPOINT);
-          else
-            transferToTask(GO_UP);
-        }
-      }
-      break;
-    }
-
-    case GO_UP:
-    {
-      if(!closeToGoalHeight())
-      {
-        droneGoUp();
-      }
-      else if(closeToGoalHeight())
-      {
-        transferToTask(GO_TO_SETPOINT);
-      }
-      break;
-    }
-
-    /*do no vision task when go to set point, only judge if close to
-    set point, when close, either go to track line or idle*/
-    case GO_TO_SETPOINT:
-    {
-      updateVisionTask();
-      updatePillarColor();
-      if(!farFromTakeoffPoint())
-      {
-        droneGoToSetPoint();
-      }
-      //      else if(discoverLandPoint())
-      //      {
-      //        transferToTask(GO_TO_LAND_POINT);
-      //      }
-      else if(discoverYellowLine())
-      {
-        transferToTask(TRACK_LINE);
-      }
-      else if(!discoverLandPoint() && !discoverYellowLine() &&
-              !closeToSetPoint())
-      {
-        droneGoToSetPoint();
-      }
-      else
-      {
-        transferToTask(IDLE);
-      }
-      break;
-    }
-
-    case TRACK_LINE:
-    {
-      if(!discoverLandPoint())
-      {
-        if(discoverYellowLine())
-        {
-          droneTrackLine();
-          if(discoverT())
-          {
-            if(nextTargetIsClosePillar())
-            {
-              // droneUpdatePosition(PA_T_1);
-              transferToTask(GO_TO_PILLAR);
-            }
-            else if(nextTargetIsFarPillar())
-            {
-              /*go forward for a while*/
-              updateTPosition();
-              transferToTask(TRACK_LINE_FORWARD);
-            }
-            else if(nextTargetIsBase())
-            {
-              updateTPosition();
-              transferToTask(TRACK_LINE_BACKWARD);
-            }
-          }
-          /*
-          //This part should be added later,T
-          if(discoverT())
-          {
-            if(nextTargetIsClosePillar())
-            {
-              transferToTask(GO_TO_PILLAR);
-            }
-            else if(nextTargetIsFarPillar())
-            {
-              transferToTask(CROSS_ARENA)
-            }
-          }
-          */
-        }
-        else
-        {
-          if(!closeToSetPoint())
-          {
-            transferToTask(GO_TO_SETPOINT);
-          }
-          else
-          {
-            transferToTask(IDLE);
-          }
-        }
-      }
-      else
-      {
-        transferToTask(GO_TO_LAND_POINT);
-      }
-      break;
-    }
-
-    case GO_TO_LAND_POINT:
-    {
-      if(stillFindLandPoint())
-      {
-        if(!readyToLand())
-        {
-          dronePrepareToLand();
-        }
-        else
-        {
-          if(landPointIsPillar())
-          {
-            openGraspper();
-            droneDropDown();
-            transferToTask(LAND);
-          }
-          else if(landPointIsBase())
-          {
-            droneHover();
-            droneHover();
-            if(isQulifying())
-            {
-              // transferToTask(LAND);
-              updateTakeoffPointId();
-              droneUpdatePosition();
-              transferToTask(GO_UP);
-            }
-            else
-            {
-              if(!isTheLastTravel())
-              {
-                transferToTask(RELEASE_BALL);
-              }
-              else
-              {
-                transferToTask(FINAL);
-              }
-            }
-          }
-        }
-      }
-      else
-      {
-        if(!closeToSetPoint())
-        {
-          transferToTask(GO_TO_SETPOINT);
-        }
-        else
-        {
-          transferToTask(IDLE);
-        }
-      }
-      break;
-    }
-
-    case LAND:
-    {
-      if(!isOnLand())
-      {
-        /* continue to land */
-        openGraspper();
-        droneLand();
-      }
-      else if(isOnLand())
-      {
-        transferToTask(GRAB_BALL);
-      }
-      break;
-    }
-
-    case GRAB_BALL:
-    {
-      if(!finishGrabBallTask())
-      {
-        /* continue graspper control */
-        grabBall();
-      }
-      else
-      {
-        closeGraspper();
-        updateTakeoffPointId();
-        droneUpdatePosition();
-        transferToTask(TAKE_OFF);
-      }
-      break;
-    }
-
-    case IDLE:
-    {
-      if(discoverLandPoint())
-      {
-        transferToTask(GO_TO_LAND_POINT);
-      }
-      else if(discoverYellowLine())
-      {
-        transferToTask(TRACK_LINE);
-      }
-      else
-      {
-        // do nothing, wait
-        droneHover();
-        ros::Duration(0.5).sleep();
-      }
-      break;
-    }
-
-    case RELEASE_BALL:
-    {
-      /*go down to lower height*/
-      if(lowEnoughToReleaseBall())
-      {
-        droneHover();
-        droneReleaseBall();
-        updateTakeoffPointId();
-        droneUpdatePosition();
-        ros::Duration(2.5).sleep();
-        transferToTask(GO_UP);
-      }
-      else
-      {
-        droneGoDownToBase();
-      }
-      break;
-    }
-
-    case CROSS_ARENA:
-    {
-      break;
-    }
-
-    case GO_TO_PILLAR:
-    {
-      droneGoToPillar();
-      if(discoverLandPoint())
-      {
-        transferToTask(GO_TO_LAND_POINT);
-      }
-      break;
-    }
-
-    case TRACK_LINE_FORWARD:
-    {
-      if(!forwardFarEnough())
-      {
-        // droneTrackLine();
-        controlDroneVelocity(PA_KT, 0.0, 0.0, 0.0);
-        ROS_INFO("forward!");
-      }
-      else
-      {
-        transferToTask(TRACK_LINE);
-      }
-      break;
-    }
-
-    case TRACK_LINE_BACKWARD:
-    {
-      if(!backwardFarEnough())
-      {
-        controlDroneVelocity(-PA_KT, 0.0, 0.0, 0.0);
-        ROS_INFO("backward!");
-      }
-      else
-      {
-        transferToTask(TRACK_LINE);
-      }
-      break;
-    }
-
-    case FINAL:
-    {
-      if(!isOnLand())
-      {
-        droneLand();
-      }
-      else if(isOnLand())
-      {
-        openGraspper();
-        ros::Duration(1.0).sleep();
-      }
-      break;
-    }
-  }
+  TASK_STATE state= m_state;
+  TASK_STATE next= runTransitions();
+  double tick_ms= (ros::WallTime::now() - tick_start).toSec() * 1000;
+  m_latency.addSample("fsm_tick", tick_ms);
+  m_latency.addSample(m_tick_stage[state], tick_ms);
+  m_state_ticks++;
+  m_state_tick_ms+= tick_ms;
+  if(tick_ms > m_state_tick_max_ms)
+    m_state_tick_max_ms= tick_ms;
+  if(next != state)
+    transferToTask(next);
 }
 
-void RMChallengeFSM::transferToTask(TASK_STATE task_state)
+void RMChallengeFSM::indexTransitions()
 {
-  if(task_state == TAKE_OFF)
-  {
-    m_state= TAKE_OFF;
-  }
-  else if(task_state == GO_UP)
-  {
-    m_state= GO_UP;
-  }
-  else if(task_state == GO_TO_SETPOINT)
-  {
-    m_state= GO_TO_SETPOINT;
-  }
-  else if(task_state == IDLE)
-  {
-    m_state= IDLE;
-  }
-  else if(task_state == TRACK_LINE)
-  {
-    m_state= TRACK_LINE;
-  }
-  else if(task_state == LAND)
-  {
-    m_state= LAND;
-  }
-  else if(task_state == GRAB_BALL)
-  {
-    m_state= GRAB_BALL;
-  }
-  else if(task_state == GO_TO_LAND_POINT)
+  for(int i= 0; i < STATE_NUM; i++)
   {
-    m_state= GO_TO_LAND_POINT;
+    m_first_transition[i]= 0;
+    m_transition_num[i]= 0;
+    m_tick_stage[i]= string("tick_") + s_state_info[i].stage;
+    m_visit_stage[i]= string("state_") + s_state_info[i].stage;
   }
-  else if(task_state == GO_TO_PILLAR)
+  for(int i= 0; i < s_transition_num; i++)
   {
-    m_state= GO_TO_PILLAR;
+    TASK_STATE state= s_transitions[i].state;
+    if(m_transition_num[state] == 0)
+      m_first_transition[state]= i;
+    /*the rows of a state must be next to each other*/
+    ROS_ASSERT(m_first_transition[state] + m_transition_num[state] == i);
+    m_transition_num[state]++;
   }
-  else if(task_state == RELEASE_BALL)
-  {
-    m_state= RELEASE_BALL;
-  }
-  else if(task_state == CROSS_ARENA)
-  {
-    m_state= CROSS_ARENA;
-  }
-  else if(task_state == TRACK_LINE_FORWARD)
+}
+
+bool RMChallengeFSM::checkCondition(CONDITION condition)
+{
+  unsigned bit= 1u << condition;
+  if(!(m_condition_known & bit))
   {
-    m_state= TRACK_LINE_FORWARD;
+    m_condition_known|= bit;
+    if((this->*s_conditions[condition])())
+      m_condition_value|= bit;
+    else
+      m_condition_value&= ~bit;
   }
-  else if(task_state == TRACK_LINE_BACKWARD)
-  {
-    m_state= TRACK_LINE_BACKWARD;
+  return (m_condition_value & bit) != 0;
+}
+
+bool RMChallengeFSM::matchTransition(const TRANSITION &transition)
+{
+  if(transition.step != m_action_step)
+    return false;
+  /*lowest condition first, stop at the first one that does not match, so
+  a condition is only evaluated when the nested ifs would have*/
+  unsigned used= transition.when_true | transition.when_false;
+  for(int c= 0; (used >> c) != 0; c++)
+  {
+    unsigned bit= 1u << c;
+    if(!(used & bit))
+      continue;
+    if(checkCondition((CONDITION)c) != ((transition.when_true & bit) != 0))
+      return false;
   }
-  else if(task_state == FINAL)
+  return true;
+}
+
+RMChallengeFSM::TASK_STATE RMChallengeFSM::runTransitions()
+{
+  m_condition_known= 0;
+  const STATE_INFO &info= s_state_info[m_state];
+  if(info.during)
+    (this->*info.during)();
+  int end= m_first_transition[m_state] + m_transition_num[m_state];
+  for(int i= m_first_transition[m_state]; i < end; i++)
   {
-    m_state= FINAL;
+    const TRANSITION &transition= s_transitions[i];
+    if(!matchTransition(transition))
+      continue;
+    if(transition.action)
+      (this->*transition.action)();
+    return transition.next;
   }
+  return m_state;
+}
+
+void RMChallengeFSM::transferToTask(TASK_STATE task_state)
+{
+  endStateVisit();
+  m_state= task_state;
+  m_action_step= 0;
+  m_action_deadline= ros::Time(0);
+  beginStateVisit();
+}
+
+void RMChallengeFSM::beginStateVisit()
+{
+  m_state_enter_time= ros::Time::now();
+  m_state_ticks= 0;
+  m_state_tick_ms= 0;
+  m_state_tick_max_ms= 0;
+}
+
+void RMChallengeFSM::endStateVisit()
+{
+  double seconds= (ros::Time::now() - m_state_enter_time).toSec();
+  float mean_ms= m_state_ticks > 0 ? m_state_tick_ms / m_state_ticks : 0;
+  m_latency.addSample(m_visit_stage[m_state], seconds * 1000);
+  g_event_log.log(EV_FSM_STATE, m_state, seconds, m_state_ticks, mean_ms,
+                  m_state_tick_max_ms);
+  ROS_INFO_STREAM("left " << s_state_info[m_state].name << " after "
+                          << seconds << "s, " << m_state_ticks
+                          << " ticks, max tick " << m_state_tick_max_ms
+                          << "ms");
+}
+
+void RMChallengeFSM::startWait(double seconds)
+{
+  m_action_deadline= ros::Time::now() + ros::Duration(seconds);
+}
+
+bool RMChallengeFSM::isWaiting()
+{
+  return ros::Time::now() < m_action_deadline;
+}
+
+bool RMChallengeFSM::takeoffFromStart()
+{
+  if(m_current_takeoff_point_id == PA_START ||
+     m_current_takeoff_point_id == PA_START_Q)
+    return true;
+  else
+    return false;
 }
 
 bool RMChallengeFSM::isTakeoffTimeout()
 {
   double t= ros::Time::now().toSec() - m_takeoff_time.toSec();
-  ROS_INFO_STREAM("time now is:" << ros::Time::now().toSec());
-  ROS_INFO_STREAM("takeoff time is:" << m_takeoff_time.toSec());
-  ROS_INFO_STREAM("Taking off time is:" << t);
+  /*checked on every tick while taking off*/
+  ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "Taking off time is:" << t);
   if(PA_TAKEOFF_TIME < t)
   {
     ROS_INFO_STREAM("Time is enough");
@@ -564,7 +473,7 @@ bool RMChallengeFSM::isTakeoffTimeout()
   }
   else
   {
-    ROS_INFO_STREAM("Time is too less");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "Time is too less");
     return false;
   }
 }
@@ -572,12 +481,12 @@ bool RMChallengeFSM::isTakingoff()
 {
   if(m_uav_state == UAV_FLY)
   {
-    ROS_INFO_STREAM("Is taking off");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "Is taking off");
     return true;
   }
   else
   {
-    ROS_INFO_STREAM("Wait to take off");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "Wait to take off");
     return false;
   }
 }
@@ -585,56 +494,61 @@ bool RMChallengeFSM::isOnLand()
 {
   if(m_uav_state == UAV_LAND)
   {
-    ROS_INFO_STREAM("on land");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "on land");
     return true;
   }
   else
   {
-    ROS_INFO_STREAM("still not on land");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "still not on land");
     return false;
   }
 }
 bool RMChallengeFSM::closeToGoalHeight()
 {
-  float height_error= fabs(m_current_height_from_guidance -
+  float height_error= fabs(m_estimate.height -
                            m_goal_height[m_current_takeoff_point_id]);
   if(height_error < PA_TAKEOFF_HEIGHT_THRESHOLD)
   {
-    ROS_INFO_STREAM("Take off height error :" << height_error << "is "
-                                                                 "small");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "Take off height error :"
+                                                << height_error << "is small");
     return true;
   }
   else
   {
-    ROS_INFO_STREAM("Take off height error:" << height_error << "is too "
-                                                                "large");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "Take off height error:"
+                                                << height_error
+                                                << "is too large");
     return false;
   }
 }
 
 bool RMChallengeFSM::farFromTakeoffPoint()
 {
-  double pos_error= sqrt(
-      pow(m_real_position[0] - m_takeoff_points[m_current_takeoff_point_id][0],
-          2) +
-      pow(m_real_position[1] - m_takeoff_points[m_current_takeoff_point_id][1],
-          2));
-  ROS_INFO_STREAM("guidance position:" << m_real_position[0] << " "
-                                       << m_real_position[1]);
-  ROS_INFO_STREAM("takeoff position:"
+  double pos_error=
+      sqrt(pow(m_estimate.position[0] -
+                   m_takeoff_points[m_current_takeoff_point_id][0],
+               2) +
+           pow(m_estimate.position[1] -
+                   m_takeoff_points[m_current_takeoff_point_id][1],
+               2));
+  ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "guidance position:"
+                                              << m_estimate.position[0] << " "
+                                              << m_estimate.position[1]);
+  ROS_INFO_STREAM_THROTTLE(
+      PA_LOG_PERIOD, "takeoff position:"
                   << m_takeoff_points[m_current_takeoff_point_id][0] << " "
                   << m_takeoff_points[m_current_takeoff_point_id][1]);
 
   if(pos_error > PA_TAKEOFF_POSITION_ERROR)
   {
-    ROS_INFO_STREAM("distance to takeoff point is:" << pos_error << ",fa"
-                                                                    "r");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "distance to takeoff point is:"
+                                                << pos_error << ",far");
     return true;
   }
   else
   {
-    ROS_INFO_STREAM("distance to takeoff point is:" << pos_error << ",too "
-                                                                    "close");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "distance to takeoff point is:"
+                                                << pos_error << ",too close");
     return false;
   }
 }
@@ -645,15 +559,18 @@ bool RMChallengeFSM::discoverTriangle()
                     m_pillar_triangle[2] + m_pillar_triangle[3];
   if(triangle_num != 0)
   {
-    ROS_INFO_STREAM("discover triangle" << triangle_num);
-    ROS_INFO_STREAM(m_pillar_triangle[0] << "," << m_pillar_triangle[1] << ", "
-                                         << m_pillar_triangle[2] << ", "
-                                         << m_pillar_triangle[3]);
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD,
+                             "discover triangle" << triangle_num);
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, m_pillar_triangle[0]
+                                                << "," << m_pillar_triangle[1]
+                                                << ", " << m_pillar_triangle[2]
+                                                << ", "
+                                                << m_pillar_triangle[3]);
     return true;
   }
   else
   {
-    ROS_INFO_STREAM("no triangle");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "no triangle");
     return false;
   }
 }
@@ -666,26 +583,26 @@ bool RMChallengeFSM::discoverLandPoint()
      m_current_takeoff_point_id == PA_PILLAR_4 ||
      m_current_takeoff_point_id == PA_START_Q)
   {
-    if(m_discover_base)
+    if(m_estimate.base_found)
     {
       m_land_point_type= BASE_LAND_POINT;
-      ROS_INFO_STREAM("discover base");
+      ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "discover base");
       return true;
     }
     else
     {
-      ROS_INFO_STREAM("no base");
+      ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "no base");
       return false;
     }
   }
   else
   {
-    bool is_pillar_found= m_discover_pillar_circle || discoverTriangle();
+    bool is_pillar_found= m_estimate.circle_found || discoverTriangle();
     float landpoint_error=
-        sqrt(pow(m_real_position[0] -
+        sqrt(pow(m_estimate.position[0] -
                      m_takeoff_points[m_current_takeoff_point_id + 1][0],
                  2) +
-             pow(m_real_position[1] -
+             pow(m_estimate.position[1] -
                      m_takeoff_points[m_current_takeoff_point_id + 1][1],
                  2));
     bool close_to_lp=
@@ -693,15 +610,18 @@ bool RMChallengeFSM::discoverLandPoint()
 
     if(!is_pillar_found)
     {
-      ROS_INFO_STREAM("no circle from vision");
+      ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "no circle from vision");
       return false;
     }
     else if(!close_to_lp)
     {
-      ROS_INFO_STREAM("far from landpoint");
-      ROS_INFO_STREAM("guidance position:" << m_real_position[0] << " "
-                                           << m_real_position[1]);
-      ROS_INFO_STREAM("takeoff position:"
+      ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "far from landpoint");
+      ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD,
+                               "guidance position:" << m_estimate.position[0]
+                                                    << " "
+                                                    << m_estimate.position[1]);
+      ROS_INFO_STREAM_THROTTLE(
+          PA_LOG_PERIOD, "takeoff position:"
                       << m_takeoff_points[m_current_takeoff_point_id + 1][0]
                       << " "
                       << m_takeoff_points[m_current_takeoff_point_id + 1][1]);
@@ -710,7 +630,8 @@ bool RMChallengeFSM::discoverLandPoint()
     else
     {
       m_land_point_type= PILLAR_LAND_POINT;
-      ROS_INFO_STREAM("circle:" << m_discover_pillar_circle);
+      ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD,
+                               "circle:" << m_estimate.circle_found);
       return true;
     }
   }
@@ -724,7 +645,7 @@ bool RMChallengeFSM::stillFindLandPoint()
      m_current_takeoff_point_id == PA_PILLAR_4 ||
      m_current_takeoff_point_id == PA_START_Q)
   {
-    if(m_discover_base)
+    if(m_estimate.base_found)
     {
       m_land_point_type= BASE_LAND_POINT;
       return true;
@@ -736,8 +657,8 @@ bool RMChallengeFSM::stillFindLandPoint()
   }
   else
   {
-    if(m_discover_pillar_circle || discoverTriangle() ||
-       m_discover_pillar_arc || m_prepare_to_land_type != PREPARE_AT_HIGH)
+    if(m_estimate.circle_found || discoverTriangle() ||
+       m_estimate.arc_found || m_prepare_to_land_type != PREPARE_AT_HIGH)
     {
       m_land_point_type= PILLAR_LAND_POINT;
       return true;
@@ -754,34 +675,34 @@ bool RMChallengeFSM::discoverYellowLine()
   if(fabs(m_distance_to_line[0]) > 0.0001 ||
      fabs(m_distance_to_line[1]) > 0.0001)
   {
-    ROS_INFO_STREAM("discover yellow detectLine");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "discover yellow detectLine");
     return true;
   }
   else
   {
-    ROS_INFO_STREAM("no yellow detectLine found");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "no yellow detectLine found");
     return false;
   }
 }
 bool RMChallengeFSM::closeToSetPoint()
 {
   float disp_x=
-      m_real_position[0] - m_takeoff_points[m_current_takeoff_point_id][0];
+      m_estimate.position[0] - m_takeoff_points[m_current_takeoff_point_id][0];
   float disp_y=
-      m_real_position[1] - m_takeoff_points[m_current_takeoff_point_id][1];
+      m_estimate.position[1] - m_takeoff_points[m_current_takeoff_point_id][1];
   double pos_error=
       sqrt(pow(disp_x - m_setpoints[m_current_takeoff_point_id][0], 2) +
            pow(disp_y - m_setpoints[m_current_takeoff_point_id][1], 2));
   if(pos_error < PA_SETPOINT_POSITION_ERROR)
   {
-    ROS_INFO_STREAM("Error to setpoint is :" << pos_error << ",clos"
-                                                             "e");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "Error to setpoint is :"
+                                                << pos_error << ",close");
     return true;
   }
   else
   {
-    ROS_INFO_STREAM("Error to setpoint is :" << pos_error << ",too "
-                                                             "far");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "Error to setpoint is :"
+                                                << pos_error << ",too far");
     return false;
   }
 }
@@ -790,12 +711,12 @@ bool RMChallengeFSM::finishGrabBallTask()
   if(m_graspper_control_time >= PA_GRASPPER_CONTROL_TIME)
   {
     m_graspper_control_time= 0;
-    ROS_INFO_STREAM("graspper  finish");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "graspper  finish");
     return true;
   }
   else
   {
-    ROS_INFO_STREAM("graspper not finish");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "graspper not finish");
     return false;
   }
 }
@@ -813,16 +734,12 @@ void RMChallengeFSM::droneLand()
 }
 void RMChallengeFSM::openGraspper()
 {
-  for(int i= 0; i < 10; i++)
-    boost::asio::write(*m_serial_port, boost::asio::buffer("b"),
-                       m_err_code);  // open graspper
+  m_serial.send(SERIAL_GRASPPER, 'b');  // open graspper
   m_graspper_state= GRASPPER_OPEN;
 }
 void RMChallengeFSM::closeGraspper()
 {
-  for(int i= 0; i < 10; i++)
-    boost::asio::write(*m_serial_port, boost::asio::buffer("a"),
-                       m_err_code);  // close graspper
+  m_serial.send(SERIAL_GRASPPER, 'a');  // close graspper
   m_graspper_state= GRASPPER_CLOSE;
 }
 
@@ -837,7 +754,6 @@ void RMChallengeFSM::grabBall()
   {
     closeGraspper();
   }
-  ros::Duration(2.0).sleep();
   ROS_INFO_STREAM("graspper state is:" << m_graspper_state);
 }
 
@@ -852,20 +768,20 @@ void RMChallengeFSM::controlDroneVelocity(float x, float y, float z, float yaw)
 #if CURRENT_COMPUTER == MANIFOLD
   m_drone->attitude_control(0x4B, x, y, z, yaw);
 #endif
-  ros::Duration(20 / 1000).sleep();
+  m_latency.record("command", m_vision_stamp);
 }
 
 void RMChallengeFSM::droneGoUp()
 {
-  if(m_goal_height[m_current_takeoff_point_id] > m_current_height_from_guidance)
+  if(m_goal_height[m_current_takeoff_point_id] > m_estimate.height)
   {
     controlDroneVelocity(0.0, 0.0, PA_GO_UP_VELOCITY, 0.0);
-    ROS_INFO_STREAM("go up");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "go up");
   }
   else
   {
     controlDroneVelocity(0.0, 0.0, -PA_GO_UP_VELOCITY, 0.0);
-    ROS_INFO_STREAM("go down");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "go down");
   }
 }
 
@@ -873,10 +789,10 @@ void RMChallengeFSM::droneGoToSetPoint()
 {
   float vt_x= 0, vt_y= 0;
   calculateTangentialVelocity(vt_x, vt_y, VIRTUAL_LINE_SETPOINT);
-  ROS_INFO_STREAM("vtx:" << vt_x << " vt_y:" << vt_y);
+  ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "vtx:" << vt_x << " vt_y:" << vt_y);
   float vn_x= 0, vn_y= 0;
   calculateNormalVelocity(vn_x, vn_y, VIRTUAL_LINE_SETPOINT);
-  ROS_INFO_STREAM("vnx:" << vn_x << " vn_y:" << vn_y);
+  ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "vnx:" << vn_x << " vn_y:" << vn_y);
   controlDroneVelocity(vt_x + vn_x, vt_y + vn_y, 0.0, 0.0);
 
   /*publish velocity*/
@@ -899,7 +815,7 @@ void RMChallengeFSM::droneTrackLine()
   calculateNormalVelocity(vn_x, vn_y, YELLOW_LINE);
   calculateZVelocity(v_z);
   calculateYawRate(yaw);
-  ROS_INFO_STREAM("\n t:" << vt_x << "," << vt_y << "\n"
+  ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "\n t:" << vt_x << "," << vt_y << "\n"
                           << "n:" << vn_x << "," << vn_y << "\n"
                           << "yaw:" << yaw << "\n"
                           << "vz:" << v_z);
@@ -915,28 +831,123 @@ void RMChallengeFSM::droneTrackLine()
   m_velocity_pub.publish(velocity);
 }
 
+/*one command per tick, the state keeps sending it as long as needed*/
 void RMChallengeFSM::droneHover()
 {
-  for(int i= 0; i < 25; i++)
-    controlDroneVelocity(0, 0, 0, 0);
-  // ros::Duration(0.5).sleep();
+  controlDroneVelocity(0, 0, 0, 0);
 }
 
 void RMChallengeFSM::droneDropDown()
 {
-  for(int i= 0; i < 200; i++)
-    controlDroneVelocity(0.0, 0.0, -0.9, 0.0);
+  controlDroneVelocity(0.0, 0.0, -0.9, 0.0);
+}
+
+void RMChallengeFSM::startTakeoff()
+{
+  closeGraspper();
+  droneTakeoff();
+  updateTakeoffTime();
+  startWait(PA_TAKEOFF_RETRY_TIME);
+}
+
+void RMChallengeFSM::updateVisionTaskAndColor()
+{
+  updateVisionTask();
+  updatePillarColor();
+}
+
+void RMChallengeFSM::trackLineFromT()
+{
+  droneTrackLine();
+  updateTPosition();
+}
+
+void RMChallengeFSM::startDropDown()
+{
+  openGraspper();
+  droneDropDown();
+  startWait(PA_DROP_DOWN_TIME);
+  m_action_step= 1;
+}
+
+/*qulification lands on the base without releasing the ball*/
+void RMChallengeFSM::leaveBase()
+{
+  droneHover();
+  nextTakeoffPoint();
+}
+
+void RMChallengeFSM::landWithGraspperOpen()
+{
+  /* continue to land */
+  openGraspper();
+  droneLand();
+}
+
+void RMChallengeFSM::startGrabBall()
+{
+  /* continue graspper control */
+  grabBall();
+  startWait(PA_GRASPPER_MOVE_TIME);
+}
+
+void RMChallengeFSM::finishGrabBall()
+{
+  closeGraspper();
+  nextTakeoffPoint();
+}
+
+void RMChallengeFSM::startReleaseBall()
+{
+  droneHover();
+  openGraspper();
+  startWait(PA_RELEASE_BALL_OPEN_TIME);
+  m_action_step= 1;
+}
+
+void RMChallengeFSM::finishReleaseBall()
+{
+  droneHover();
+  closeGraspper();
+  nextTakeoffPoint();
+  startWait(PA_RELEASE_BALL_WAIT_TIME);
+  m_action_step= 2;
+}
+
+void RMChallengeFSM::openFinalGraspper()
+{
+  openGraspper();
+  startWait(PA_FINAL_OPEN_TIME);
+}
+
+void RMChallengeFSM::droneGoForward()
+{
+  // droneTrackLine();
+  controlDroneVelocity(PA_KT, 0.0, 0.0, 0.0);
+  ROS_INFO_THROTTLE(PA_LOG_PERIOD, "forward!");
+}
+
+void RMChallengeFSM::droneGoBackward()
+{
+  controlDroneVelocity(-PA_KT, 0.0, 0.0, 0.0);
+  ROS_INFO_THROTTLE(PA_LOG_PERIOD, "backward!");
+}
+
+void RMChallengeFSM::nextTakeoffPoint()
+{
+  updateTakeoffPointId();
+  droneUpdatePosition();
 }
 
 bool RMChallengeFSM::readyToLand()
 {
-  float land_err= sqrt(pow(m_circle_position_error[0], 2) +
-                       pow(m_circle_position_error[1], 2));
+  float land_err= sqrt(pow(m_estimate.circle_error[0], 2) +
+                       pow(m_estimate.circle_error[1], 2));
   float height_error;
   if(m_land_point_type == BASE_LAND_POINT)
   {
-    if(fabs(m_base_angle) < PA_BASE_ANGLE_THRESHOLD &&
-       (m_base_state == BASE_ANGLE) && m_discover_base)
+    if(fabs(m_estimate.base_angle) < PA_BASE_ANGLE_THRESHOLD &&
+       (m_base_state == BASE_ANGLE) && m_estimate.base_found)
     {
       // ROS_INFO_STREAM("ready to land at base," << land_err << ","
       //                                          << height_error);
@@ -952,11 +963,11 @@ bool RMChallengeFSM::readyToLand()
   }
   else if(m_land_point_type == PILLAR_LAND_POINT)
   {
-    height_error= fabs(PA_LAND_HEIGHT_FINAL - m_current_height_from_guidance);
+    height_error= fabs(PA_LAND_HEIGHT_FINAL - m_estimate.height);
     float oror=
-        sqrt(pow(m_arc_position_error[0], 2) + pow(m_arc_position_error[1], 2));
-    float pos_error_x= fabs(m_arc_position_error[0]);
-    float pos_error_y= fabs(m_arc_position_error[1]);
+        sqrt(pow(m_estimate.arc_error[0], 2) + pow(m_estimate.arc_error[1], 2));
+    float pos_error_x= fabs(m_estimate.arc_error[0]);
+    float pos_error_y= fabs(m_estimate.arc_error[1]);
     // need output
     if(m_prepare_to_land_type == PREPARE_AT_SUPER_LOW &&
        pos_error_x < PA_LAND_POSITION_THRESHOLD_SUPER_LOW &&
@@ -1008,8 +1019,9 @@ void RMChallengeFSM::dronePrepareToLand()
   if(m_land_point_type == BASE_LAND_POINT)
   {
     navigateByQRCode(vx, vy, vz, yaw);
-    ROS_INFO_STREAM("landing at base v are:" << vx << "," << vy << "," << vz
-                                             << "," << yaw);
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "landing at base v are:"
+                                                << vx << "," << vy << "," << vz
+                                                << "," << yaw);
   }
   else if(m_land_point_type == PILLAR_LAND_POINT)
   {
@@ -1018,24 +1030,26 @@ void RMChallengeFSM::dronePrepareToLand()
       navigateByArc(vx, vy, vz);
       velocity_id= "by arc";
     }
-    else if(m_discover_pillar_circle)
+    else if(m_estimate.circle_found)
     {
       navigateByCircle(vx, vy, vz);
       velocity_id= "by circle";
-      ROS_INFO("by circle ");
+      ROS_INFO_THROTTLE(PA_LOG_PERIOD, "by circle ");
     }
     else if(discoverTriangle())
     {
       navigateByTriangle(vx, vy, vz);
       velocity_id= "by triangle";
-      ROS_INFO_STREAM("navigate by triangle");
+      ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "navigate by triangle");
     }
     else
     {
-      ROS_INFO_STREAM("Miss pillar!!!");
+      ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "Miss pillar!!!");
       velocity_id= "miss pillar";
     }
-    ROS_INFO_STREAM("landing v at pillar are:" << vx << "," << vy << "," << vz);
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "landing v at pillar are:"
+                                                << vx << "," << vy << ","
+                                                << vz);
   }
   controlDroneVelocity(vx, vy, vz, yaw);
 
@@ -1044,8 +1058,8 @@ void RMChallengeFSM::dronePrepareToLand()
   if(velocity_id == "by arc")
   {
     /*publish position and height error to compare*/
-    publishVelocity("arc error", m_arc_position_error[0],
-                    m_arc_position_error[1], m_current_height_from_guidance);
+    publishVelocity("arc error", m_estimate.arc_error[0],
+                    m_estimate.arc_error[1], m_estimate.height);
   }
 }
 
@@ -1062,16 +1076,16 @@ void RMChallengeFSM::publishVelocity(std::string id, float x, float y, float z)
 
 void RMChallengeFSM::navigateByCircle(float &vx, float &vy, float &vz)
 {
-  ROS_INFO_STREAM("navigate by circle");
+  ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "navigate by circle");
   if(m_prepare_to_land_type == PREPARE_AT_HIGH)
   {
-    ROS_INFO_STREAM("navigate high");
-    float land_err= sqrt(pow(m_circle_position_error[0], 2) +
-                         pow(m_circle_position_error[1], 2));
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "navigate high");
+    float land_err= sqrt(pow(m_estimate.circle_error[0], 2) +
+                         pow(m_estimate.circle_error[1], 2));
     if(land_err > PA_LAND_POSITION_THRESHOLD_HIGH)
     {
-      vx= PA_KP_PILLAR_HIGH * m_circle_position_error[0];
-      vy= PA_KP_PILLAR_HIGH * m_circle_position_error[1];
+      vx= PA_KP_PILLAR_HIGH * m_estimate.circle_error[0];
+      vy= PA_KP_PILLAR_HIGH * m_estimate.circle_error[1];
       vz= 0;
       if(fabs(vx) < PA_V_MIN_HIGH)
         vx= fabs(vx) / (vx + 0.0001) * PA_V_MIN_HIGH;
@@ -1081,7 +1095,7 @@ void RMChallengeFSM::navigateByCircle(float &vx, float &vy, float &vz)
     else
     {
       vx= vy= 0.0;
-      float height_error= PA_LAND_HEIGHT - m_current_height_from_circle;
+      float height_error= PA_LAND_HEIGHT - m_estimate.circle_height;
       if(fabs(height_error) > PA_LAND_HEIGHT_THRESHOLD)
       {
         vz= fabs(height_error) / (height_error + 0.0000000001) *
@@ -1101,9 +1115,9 @@ void RMChallengeFSM::navigateByCircle(float &vx, float &vy, float &vz)
   else if(m_prepare_to_land_type == PREPARE_AT_LOW)
   {
     /*only use circle position error to adjust position*/
-    ROS_INFO_STREAM("navigate at low");
-    vx= PA_KP_PILLAR_LOW * m_circle_position_error[0];
-    vy= PA_KP_PILLAR_LOW * m_circle_position_error[1];
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "navigate at low");
+    vx= PA_KP_PILLAR_LOW * m_estimate.circle_error[0];
+    vy= PA_KP_PILLAR_LOW * m_estimate.circle_error[1];
     vz= 0;
     if(fabs(vx) < PA_V_MIN_LOW)
       vx= fabs(vx) / (vx + 0.0001) * PA_V_MIN_LOW;
@@ -1112,8 +1126,8 @@ void RMChallengeFSM::navigateByCircle(float &vx, float &vy, float &vz)
 
     /*shift to PREPARE_AT_SUPER_LOW when position error
     is small enough */
-    float land_err= sqrt(pow(m_circle_position_error[0], 2) +
-                         pow(m_circle_position_error[1], 2));
+    float land_err= sqrt(pow(m_estimate.circle_error[0], 2) +
+                         pow(m_estimate.circle_error[1], 2));
     if(land_err < PA_LAND_POSITION_THRESHOLD_LOW)
     {
       m_prepare_to_land_type= PREPARE_AT_SUPER_LOW;
@@ -1123,21 +1137,21 @@ void RMChallengeFSM::navigateByCircle(float &vx, float &vy, float &vz)
 
 void RMChallengeFSM::navigateByArc(float &vx, float &vy, float &vz)
 {
-  ROS_INFO_STREAM("navigate at super low");
-  float height_error= PA_LAND_HEIGHT_FINAL - m_current_height_from_guidance;
+  ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "navigate at super low");
+  float height_error= PA_LAND_HEIGHT_FINAL - m_estimate.height;
   float pos_error=
-      sqrt(pow(m_arc_position_error[0], 2) + pow(m_arc_position_error[1], 2));
-  float pos_error_x= m_arc_position_error[0];
-  float pos_error_y= m_arc_position_error[1];
+      sqrt(pow(m_estimate.arc_error[0], 2) + pow(m_estimate.arc_error[1], 2));
+  float pos_error_x= m_estimate.arc_error[0];
+  float pos_error_y= m_estimate.arc_error[1];
   if(fabs(pos_error_x) > PA_LAND_POSITION_THRESHOLD_SUPER_LOW_BIG ||
      fabs(pos_error_y) > PA_LAND_POSITION_THRESHOLD_SUPER_LOW_BIG)
   {
     vz= 0;
     vx= fabs(pos_error_x) > PA_LAND_POSITION_THRESHOLD_SUPER_LOW_BIG ?
-            PA_KP_PILLAR_LOW * m_arc_position_error[0] :
+            PA_KP_PILLAR_LOW * m_estimate.arc_error[0] :
             0;
     vy= fabs(pos_error_y) > PA_LAND_POSITION_THRESHOLD_SUPER_LOW_BIG ?
-            PA_KP_PILLAR_LOW * m_arc_position_error[1] :
+            PA_KP_PILLAR_LOW * m_estimate.arc_error[1] :
             0;
   }
   else if(fabs(height_error) > PA_LAND_HEIGHT_THRESHOLD_FINAL)
@@ -1146,19 +1160,19 @@ void RMChallengeFSM::navigateByArc(float &vx, float &vy, float &vz)
     vz= fabs(height_error) / (height_error + 0.0000000001) *
         PA_LAND_Z_VELOCITY_FINAL;
     vx= fabs(pos_error_x) > PA_LAND_POSITION_THRESHOLD_SUPER_LOW ?
-            PA_KP_PILLAR_LOW * m_arc_position_error[0] :
+            PA_KP_PILLAR_LOW * m_estimate.arc_error[0] :
             0;
     vy= fabs(pos_error_y) > PA_LAND_POSITION_THRESHOLD_SUPER_LOW ?
-            PA_KP_PILLAR_LOW * m_arc_position_error[1] :
+            PA_KP_PILLAR_LOW * m_estimate.arc_error[1] :
             0;
   }
   else
   {
     vz= 0;
-    vx= PA_V_MIN_FINAL * fabs(m_arc_position_error[0]) /
-        (m_arc_position_error[0] + 0.00000001);
-    vy= PA_V_MIN_FINAL * fabs(m_arc_position_error[1]) /
-        (m_arc_position_error[1] + 0.00000001);
+    vx= PA_V_MIN_FINAL * fabs(m_estimate.arc_error[0]) /
+        (m_estimate.arc_error[0] + 0.00000001);
+    vy= PA_V_MIN_FINAL * fabs(m_estimate.arc_error[1]) /
+        (m_estimate.arc_error[1] + 0.00000001);
   }
 }
 
@@ -1178,7 +1192,8 @@ void RMChallengeFSM::navigateByTriangle(float &x, float &y, float &z)
   {
     triangle_velocity= PA_LAND_TRIANGLE_VELOCITY_LOW;
   }
-  ROS_INFO_STREAM("prepare type:" << m_prepare_to_land_type);
+  ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD,
+                           "prepare type:" << m_prepare_to_land_type);
 
   if(triangle_sum == 1)
   {
@@ -1266,8 +1281,8 @@ void RMChallengeFSM::calculateNormalVelocity(float &x, float &y,
 {
   if(line_type == VIRTUAL_LINE_SETPOINT)
   {
-    float xc= m_real_position[0];
-    float yc= m_real_position[1];
+    float xc= m_estimate.position[0];
+    float yc= m_estimate.position[1];
     float x0= m_takeoff_points[m_current_takeoff_point_id][0];
     float y0= m_takeoff_points[m_current_takeoff_point_id][1];
     float xs= x0 + m_setpoints[m_current_takeoff_point_id][0];
@@ -1311,8 +1326,8 @@ void RMChallengeFSM::calculateTangentialVelocity(float &x, float &y,
 
   else if(line_type == VIRTUAL_LINE_LANDPOINT)
   {
-    float x0= m_real_position[0];
-    float y0= m_real_position[1];
+    float x0= m_estimate.position[0];
+    float y0= m_estimate.position[1];
     float xs= m_takeoff_points[m_current_takeoff_point_id + 1][0];
     float ys= m_takeoff_points[m_current_takeoff_point_id + 1][1];
     x= PA_KT * (xs - x0) / sqrt(pow(xs - x0, 2) + pow(ys - y0, 2));
@@ -1326,7 +1341,7 @@ void RMChallengeFSM::calculateYawRate(float &yaw)
   //                                    m_line_normal[1] *
   //                                    sqrt(0.75));
 
-  ROS_INFO_STREAM("angle is:" << angle_to_line_1);
+  ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "angle is:" << angle_to_line_1);
 
   if(fabs(angle_to_line_1) < PA_ANGLE_WITH_DIRECT_LINE_THRESHOLD)
   {
@@ -1364,6 +1379,92 @@ void RMChallengeFSM::calculateYawRate(float &yaw)
   // }
 }
 void RMChallengeFSM::setDroneState(int state)
+{
+  m_drone_state_input.write(state);
+}
+
+void RMChallengeFSM::setHeightFromGuidance(float height,
+                                           const ros::Time &stamp)
+{
+  HEIGHT_INPUT input;
+  input.stamp= stamp.isZero() ? ros::Time::now().toSec() : stamp.toSec();
+  input.height= height;
+  m_height_input.write(input);
+  g_event_log.log(EV_GUIDANCE_HEIGHT, 0, height);
+}
+
+void RMChallengeFSM::setPositionFromGuidance(float x, float y,
+                                             const ros::Time &stamp)
+{
+  POSITION_INPUT input;
+  input.stamp= stamp.isZero() ? ros::Time::now().toSec() : stamp.toSec();
+  input.x= x;
+  input.y= y;
+  m_position_input.write(input);
+}
+
+void RMChallengeFSM::applyInputs()
+{
+  /*drone state first, the guidance position depends on it*/
+  int state;
+  unsigned count= m_drone_state_input.read(state);
+  if(count != m_applied_input[INPUT_DRONE_STATE])
+  {
+    m_applied_input[INPUT_DRONE_STATE]= count;
+    applyDroneState(state);
+  }
+
+  HEIGHT_INPUT height;
+  count= m_height_input.read(height);
+  if(count != m_applied_input[INPUT_HEIGHT])
+  {
+    m_applied_input[INPUT_HEIGHT]= count;
+    m_estimator.updateHeight(height.stamp, height.height);
+  }
+
+  POSITION_INPUT position;
+  count= m_position_input.read(position);
+  if(count != m_applied_input[INPUT_POSITION])
+  {
+    m_applied_input[INPUT_POSITION]= count;
+    applyPositionFromGuidance(position.stamp, position.x, position.y);
+  }
+
+  PILLAR_INPUT pillar;
+  count= m_pillar_input.read(pillar);
+  if(count != m_applied_input[INPUT_PILLAR])
+  {
+    m_applied_input[INPUT_PILLAR]= count;
+    updateVisionStamp(ros::Time(pillar.stamp));
+    setCircleVariables(pillar.stamp, pillar.circle_found,
+                       pillar.circle_position, pillar.height);
+    setTriangleVariables(pillar.triangle);
+    setArcVariables(pillar.stamp, pillar.arc_found, pillar.arc_position);
+  }
+
+  BASE_INPUT base;
+  count= m_base_input.read(base);
+  if(count != m_applied_input[INPUT_BASE])
+  {
+    m_applied_input[INPUT_BASE]= count;
+    updateVisionStamp(ros::Time(base.stamp));
+    setBaseVariables(base.stamp, base.found, base.position, base.angle);
+  }
+
+  LINE_INPUT line;
+  count= m_line_input.read(line);
+  if(count != m_applied_input[INPUT_LINE])
+  {
+    m_applied_input[INPUT_LINE]= count;
+    updateVisionStamp(ros::Time(line.stamp));
+    setLineVariables(line.T_found, line.distance, line.normal);
+  }
+
+  /*everything the tick reads, at the time of the tick*/
+  m_estimator.predict(ros::Time::now().toSec(), m_estimate);
+}
+
+void RMChallengeFSM::applyDroneState(int state)
 {
   if(state == 1)
   {
@@ -1373,71 +1474,43 @@ void RMChallengeFSM::setDroneState(int state)
   {
     m_uav_state= UAV_FLY;
   }
-  ROS_INFO_STREAM("uav_state is:" << m_uav_state);
-}
-void RMChallengeFSM::setHeightFromGuidance(float height)
-{
-  m_current_height_from_guidance= height;
-  ROS_INFO_STREAM("height from guidance is:" << m_current_height_from_guidance);
+  g_event_log.log(EV_UAV_STATE, m_uav_state);
 }
 /**
 *set position from guidance
 *when on land, bias of guidance position is updated
 *when flying, use real time gudance position and bias to
 *update actual guidance position
+*both in the estimator, once per guidance measurement
 */
-void RMChallengeFSM::setPositionFromGuidance(float x, float y)
+void RMChallengeFSM::applyPositionFromGuidance(double stamp, float x, float y)
 {
   transformCoordinate(PA_COORDINATE_TRANSFORM_ANGLE, x, y);
-  m_raw_guidance_position[0]= x;
-  m_raw_guidance_position[1]= y;
-  if(m_uav_state == UAV_LAND)
-  {
-    /* update guidance bias*/
-    m_guidance_bias[0]= x - m_real_position[0];
-    m_guidance_bias[1]= y - m_real_position[1];
-    ROS_INFO_STREAM("guidance bias is:" << m_guidance_bias[0] << ","
-                                        << m_guidance_bias[1]);
-  }
-  else if(m_uav_state == UAV_FLY)
+  m_estimator.updateGuidancePosition(stamp, x, y, m_uav_state == UAV_LAND);
+  UAV_ESTIMATE estimate;
+  m_estimator.predict(stamp, estimate);
+  const float *bias= m_estimator.getGuidanceBias();
+  if(m_uav_state == UAV_FLY)
   {
-    /* update actual position */
-    m_real_position[0]= x - m_guidance_bias[0];
-    m_real_position[1]= y - m_guidance_bias[1];
-    ROS_INFO_STREAM("position from guidance is:" << m_real_position[0] << ","
-                                                 << m_real_position[1]);
-
     /*publish position*/
     geometry_msgs::Vector3Stamped pos;
     pos.header.frame_id= "position";
-    pos.header.stamp= ros::Time::now();
-    pos.vector.x= m_real_position[0];
-    pos.vector.y= m_real_position[1];
+    pos.header.stamp= ros::Time(stamp);
+    pos.vector.x= estimate.position[0];
+    pos.vector.y= estimate.position[1];
     pos.vector.z= 0.0;
     m_position_pub.publish(pos);
   }
+  g_event_log.log(EV_GUIDANCE_POSITION, m_uav_state, estimate.position[0],
+                  estimate.position[1], bias[0], bias[1]);
 }
 
-void RMChallengeFSM::setCircleVariables(bool is_circle_found,
+void RMChallengeFSM::setCircleVariables(double stamp, bool is_circle_found,
                                         float position_error[2], float height)
 {
-  m_discover_pillar_circle= is_circle_found;
-  if(is_circle_found)
-  {
-    m_circle_position_error[0]= position_error[0] - PA_CAMERA_DISPLACE;
-    m_circle_position_error[1]= position_error[1];
-    m_current_height_from_circle= height;
-  }
-  else
-  {
-    m_circle_position_error[0]= m_circle_position_error[1]=
-        m_current_height_from_circle= 0;
-  }
-  // ROS_INFO_STREAM("circle var is:"
-  //                 << m_discover_pillar_circle << ","
-  //                 << m_circle_position_error[0] << ","
-  //                 << m_circle_position_error[1] << ","
-  //                 << m_current_height_from_circle);
+  m_estimator.updateCircle(stamp, is_circle_found,
+                           position_error[0] - PA_CAMERA_DISPLACE,
+                           position_error[1], height);
 }
 
 void RMChallengeFSM::setTriangleVariables(int pillar_triangle[4])
@@ -1446,24 +1519,25 @@ void RMChallengeFSM::setTriangleVariables(int pillar_triangle[4])
   {
     m_pillar_triangle[i]= pillar_triangle[i];
   }
-  ROS_INFO_STREAM("triangle is:"
+  ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "triangle is:"
                   << pillar_triangle[0] << "," << pillar_triangle[1] << ","
                   << pillar_triangle[2] << "," << pillar_triangle[3]);
 }
 
-void RMChallengeFSM::setArcVariables(bool is_arc_found, float position_error[2])
+void RMChallengeFSM::setArcVariables(double stamp, bool is_arc_found,
+                                     float position_error[2])
 {
-  /*transform pixel position error to metric error*/
-  calculateRealPositionError(position_error);
-
-  m_arc_position_error[0]= position_error[0] - PA_CAMERA_DISPLACE;
-  m_arc_position_error[1]= position_error[1];
-  m_discover_pillar_arc= is_arc_found;
+  /*transform pixel position error to metric error, at the height the
+  frame was taken at*/
+  calculateRealPositionError(position_error,
+                             m_estimator.getHeightAt(stamp));
+  m_estimator.updateArc(stamp, is_arc_found,
+                        position_error[0] - PA_CAMERA_DISPLACE,
+                        position_error[1]);
 }
 
-void RMChallengeFSM::calculateRealPositionError(float error[2])
+void RMChallengeFSM::calculateRealPositionError(float error[2], float z)
 {
-  float z= m_current_height_from_guidance;
   float x= error[0], y= error[1];
 
   /*pin hole camera model*/
@@ -1471,25 +1545,12 @@ void RMChallengeFSM::calculateRealPositionError(float error[2])
   error[1]= z * y / PA_CAMERA_F;
 }
 
-void RMChallengeFSM::setBaseVariables(bool is_base_found,
+void RMChallengeFSM::setBaseVariables(double stamp, bool is_base_found,
                                       float position_error[2], float base_angle)
 {
-  m_discover_base= is_base_found;
-  if(is_base_found)
-  {
-    m_base_position_error[0]= position_error[0] + PA_CAMERA_DISPLACE;
-    m_base_position_error[1]= position_error[1];
-    m_base_angle= base_angle;
-  }
-  else
-  {
-    m_base_position_error[0]= 0;
-    m_base_position_error[1]= 0;
-    m_base_angle= 0.0;
-  }
-  // ROS_INFO_STREAM("base var is:" << m_discover_base << ","
-  //                                << m_base_position_error[0] << ","
-  //                                << m_base_position_error[1]);
+  m_estimator.updateBase(stamp, is_base_found,
+                         position_error[0] + PA_CAMERA_DISPLACE,
+                         position_error[1], base_angle);
 }
 void RMChallengeFSM::setLineVariables(bool is_T_found,
                                       float distance_to_line[2],
@@ -1506,6 +1567,55 @@ void RMChallengeFSM::setLineVariables(bool is_T_found,
   //                 << m_line_normal[0] << "," << m_line_normal[1]);
 }
 
+void RMChallengeFSM::updateVisionStamp(const ros::Time &stamp)
+{
+  if(stamp > m_vision_stamp)
+    m_vision_stamp= stamp;
+}
+
+void RMChallengeFSM::setPillarResult(const test2::PillarResult &result)
+{
+  m_latency.record("pillar_received", result.header.stamp);
+  PILLAR_INPUT input;
+  input.stamp= result.header.stamp.toSec();
+  /*image x is the second axis of the uav*/
+  input.circle_found= result.circle_found;
+  input.circle_position[0]= result.circle_y;
+  input.circle_position[1]= result.circle_x;
+  input.height= result.height;
+  for(int i= 0; i < 4; i++)
+    input.triangle[i]= result.triangle[i];
+  input.arc_found= result.arc_found;
+  input.arc_position[0]= result.arc_y;
+  input.arc_position[1]= result.arc_x;
+  m_pillar_input.write(input);
+}
+
+void RMChallengeFSM::setBaseResult(const test2::BaseResult &result)
+{
+  m_latency.record("base_received", result.header.stamp);
+  BASE_INPUT input;
+  input.stamp= result.header.stamp.toSec();
+  input.found= result.position_found;
+  input.position[0]= result.x;
+  input.position[1]= result.y;
+  input.angle= result.direction;
+  m_base_input.write(input);
+}
+
+void RMChallengeFSM::setLineResult(const test2::LineResult &result)
+{
+  m_latency.record("line_received", result.header.stamp);
+  LINE_INPUT input;
+  input.stamp= result.header.stamp.toSec();
+  input.T_found= result.T_found;
+  input.distance[0]= result.distance_x;
+  input.distance[1]= result.distance_y;
+  input.normal[0]= result.direction_x;
+  input.normal[1]= result.direction_y;
+  m_line_input.write(input);
+}
+
 bool RMChallengeFSM::landPointIsPillar()
 {
   if(m_current_takeoff_point_id == PA_START ||
@@ -1576,7 +1686,7 @@ bool RMChallengeFSM::nextTargetIsFarPillar()
 
 bool RMChallengeFSM::lowEnoughToReleaseBall()
 {
-  if(fabs(m_current_height_from_guidance - PA_RELEASE_BALL_HEIGHT) >
+  if(fabs(m_estimate.height - PA_RELEASE_BALL_HEIGHT) >
      PA_RELEASE_BALL_HEIGHT_THRESHOLD)
   {
     return false;
@@ -1587,21 +1697,14 @@ bool RMChallengeFSM::lowEnoughToReleaseBall()
   }
 }
 
-void RMChallengeFSM::droneReleaseBall()
-{
-  openGraspper();
-  ros::Duration(1.5).sleep();
-  closeGraspper();
-}
-
 void RMChallengeFSM::droneGoDownToBase()
 {
   /*go down faster when height is large,
    slower when height is small*/
-  float vz= PA_RELEASE_BALL_HEIGHT > m_current_height_from_guidance ?
+  float vz= PA_RELEASE_BALL_HEIGHT > m_estimate.height ?
                 PA_RELEASE_BALL_VELOCITY :
                 -PA_RELEASE_BALL_VELOCITY;
-  if((m_current_height_from_guidance - PA_RELEASE_BALL_HEIGHT) >
+  if((m_estimate.height - PA_RELEASE_BALL_HEIGHT) >
      PA_SLOW_DOWN_HEIGHT)
   {
     vz*= 4;
@@ -1622,10 +1725,10 @@ bool RMChallengeFSM::discoverT()
     correct takeoff point id,
     distance to landpoint close enough
   */
-  ROS_INFO_STREAM("looking for T");
+  ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "looking for T");
   if(m_already_find_T)
   {
-    ROS_INFO_STREAM("Already find T");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "Already find T");
     return false;
   }
   bool is_takeoff_id_correct= m_current_takeoff_point_id == PA_BASE_1 ||
@@ -1634,32 +1737,33 @@ bool RMChallengeFSM::discoverT()
                               m_current_takeoff_point_id == PA_PILLAR_3;
   if(!is_takeoff_id_correct)
   {
-    ROS_INFO_STREAM("ID wrong");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "ID wrong");
     return false;
   }
 
   if(!m_discover_T)
   {
-    ROS_INFO_STREAM("no T from vision");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "no T from vision");
     return false;
   }
 
   float pos_error= sqrt(
-      pow(m_real_position[0] - m_takeoff_points[PA_PILLAR_2][0], 2) +
-      pow(m_real_position[1] - m_takeoff_points[PA_PILLAR_2][1] - PA_T_DISPLACE,
+      pow(m_estimate.position[0] - m_takeoff_points[PA_PILLAR_2][0], 2) +
+      pow(m_estimate.position[1] - m_takeoff_points[PA_PILLAR_2][1] -
+              PA_T_DISPLACE,
           2));
   bool is_close_to_target=
       pos_error < PA_LANDPOINT_POSITION_ERROR ? true : false;
 
   if(is_close_to_target)
   {
-    ROS_INFO_STREAM("TTTTTTTTTTTTTTTTTTTT");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "TTTTTTTTTTTTTTTTTTTT");
     m_already_find_T= true;
     return true;
   }
   else
   {
-    ROS_INFO_STREAM("too far from T");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "too far from T");
     return false;
   }
 }
@@ -1681,102 +1785,35 @@ void RMChallengeFSM::droneUpdatePosition(int POSITION_ID)
   /*set pisition from guidance to according point,then update bias */
   if(POSITION_ID <= PA_PILLAR_Q)
   {
-    m_real_position[0]= m_takeoff_points[POSITION_ID][0];
-    m_real_position[1]= m_takeoff_points[POSITION_ID][1];
-    m_guidance_bias[0]= m_raw_guidance_position[0] - m_real_position[0];
-    m_guidance_bias[1]= m_raw_guidance_position[1] - m_real_position[1];
+    m_estimator.setPosition(m_takeoff_points[POSITION_ID][0],
+                            m_takeoff_points[POSITION_ID][1]);
+    /*the rest of the tick sees the new position*/
+    m_estimate.position[0]= m_takeoff_points[POSITION_ID][0];
+    m_estimate.position[1]= m_takeoff_points[POSITION_ID][1];
   }
   /*else if(POSITION_ID == PA_T_1)
   {
-    m_real_position[0]= m_takeoff_points[PA_PILLAR_2][0];
-    m_real_position[1]=
+    m_estimate.position[0]= m_takeoff_points[PA_PILLAR_2][0];
+    m_estimate.position[1]=
         m_takeoff_points[PA_PILLAR_2][1] + PA_T_DISPLACE;
   }
   else if(POSITION_ID == PA_T_2)
   {
-    m_real_position[0]= m_takeoff_points[PA_PILLAR_4][0];
-    m_real_position[1]=
+    m_estimate.position[0]= m_takeoff_points[PA_PILLAR_4][0];
+    m_estimate.position[1]=
         m_takeoff_points[PA_PILLAR_4][1] - PA_T_DISPLACE;
   }*/
 }
 
 void RMChallengeFSM::printStateInfo()
 {
-  std::string s;
-  switch(m_state)
-  {
-    case TAKE_OFF:
-    {
-      s= "TAKE OFF";
-      break;
-    }
-    case GO_UP:
-    {
-      s= "GO UP";
-      break;
-    }
-    case GO_TO_SETPOINT:
-    {
-      s= "GO TO SETPOINT";
-      break;
-    }
-    case IDLE:
-    {
-      s= "IDLE";
-      break;
-    }
-    case TRACK_LINE:
-    {
-      s= "TRACK LINE";
-      break;
-    }
-    case LAND:
-    {
-      s= "LAND";
-      break;
-    }
-    case GRAB_BALL:
-    {
-      s= "GRAB BALL";
-      break;
-    }
-    case GO_TO_LAND_POINT:
-    {
-      s= "GO TO LANDPOINT";
-      break;
-    }
-    case GO_TO_PILLAR:
-    {
-      s= "GO TO PILLAR";
-      break;
-    }
-    case RELEASE_BALL:
-    {
-      s= "RELEASE BALL";
-      break;
-    }
-    case CROSS_ARENA:
-    {
-      s= "CROSS ARENA";
-      break;
-    }
-    case TRACK_LINE_FORWARD:
-    {
-      s= "TRACK LINE FORWARD";
-      break;
-    }
-    case TRACK_LINE_BACKWARD:
-    {
-      s= "TRACK LINE BACKWARD";
-      break;
-    }
-    case FINAL:
-    {
-      s= "FINAL";
-      break;
-    }
-  }
-  ROS_INFO_STREAM("\n State is: " << s);
+  g_event_log.log(EV_FSM_TICK, m_state, m_estimate.height,
+                  m_estimate.position[0], m_estimate.position[1]);
+  /*every tick is in the event log, rosout only gets the changes*/
+  if(m_state == m_printed_state)
+    return;
+  m_printed_state= m_state;
+  ROS_INFO_STREAM("\n State is: " << s_state_info[m_state].name);
 }
 
 void RMChallengeFSM::judgeLineDirection()
@@ -1872,11 +1909,11 @@ void RMChallengeFSM::publishPillarChange(std::string state)
     msg.data= state;
     for(int i= 0; i < 5; i++)
       m_pillar_change_pub.publish(msg);
-    ROS_INFO_STREAM("info pillar task change");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "info pillar task change");
   }
   else
   {
-    ROS_INFO_STREAM("invalid state change");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "invalid state change");
   }
 }
 
@@ -1888,11 +1925,11 @@ void RMChallengeFSM::publishLineChange(std::string state)
     msg.data= state;
     for(int i= 0; i < 5; i++)
       m_line_change_pub.publish(msg);
-    ROS_INFO_STREAM("info line task change");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "info line task change");
   }
   else
   {
-    ROS_INFO_STREAM("invalid state change");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "invalid state change");
   }
 }
 
@@ -1904,11 +1941,11 @@ void RMChallengeFSM::publishBaseChange(std::string state)
     msg.data= state;
     for(int i= 0; i < 5; i++)
       m_base_change_pub.publish(msg);
-    ROS_INFO_STREAM("info base task change");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "info base task change");
   }
   else
   {
-    ROS_INFO_STREAM("invalid state change");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "invalid state change");
   }
 }
 
@@ -1962,10 +1999,11 @@ void RMChallengeFSM::publishColorChange(std::string color)
     msg.data= color;
     for(int i= 0; i < 5; i++)
       m_color_change_pub.publish(msg);
-    ROS_INFO_STREAM("inform camera pillar color change:" << msg.data);
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD,
+                             "inform camera pillar color change:" << msg.data);
   }
   else
-    ROS_INFO_STREAM("invalid color change");
+    ROS_INFO_STREAM_THROTTLE(PA_LOG_PERIOD, "invalid color change");
 }
 
 void RMChallengeFSM::calculateZVelocity(float &vz)
@@ -1981,10 +2019,10 @@ void RMChallengeFSM::calculateZVelocity(float &vz)
   {
     case PA_PILLAR_1:
     {
-      if(fabs(m_current_height_from_guidance - PA_FLYING_HEIGHT_LOW) >
+      if(fabs(m_estimate.height - PA_FLYING_HEIGHT_LOW) >
          PA_FLYING_HEIGHT_THRESHOLD)
       {
-        vz= PA_FLYING_HEIGHT_LOW > m_current_height_from_guidance ?
+        vz= PA_FLYING_HEIGHT_LOW > m_estimate.height ?
                 PA_FLYING_Z_VELOCITY :
                 -PA_FLYING_Z_VELOCITY;
       }
@@ -1995,10 +2033,10 @@ void RMChallengeFSM::calculateZVelocity(float &vz)
 
     case PA_START_Q:
     {
-      if(fabs(m_current_height_from_guidance - PA_FLYING_HEIGHT_LOW) >
+      if(fabs(m_estimate.height - PA_FLYING_HEIGHT_LOW) >
          PA_FLYING_HEIGHT_THRESHOLD)
       {
-        vz= PA_FLYING_HEIGHT_LOW > m_current_height_from_guidance ?
+        vz= PA_FLYING_HEIGHT_LOW > m_estimate.height ?
                 PA_FLYING_Z_VELOCITY :
                 -PA_FLYING_Z_VELOCITY;
       }
@@ -2012,10 +2050,10 @@ void RMChallengeFSM::calculateZVelocity(float &vz)
       /*higher at direct line*/
       if(fabs(m_line_normal[0] > 0.9))
       {
-        if(fabs(m_current_height_from_guidance - PA_FLYING_HEIGHT) >
+        if(fabs(m_estimate.height - PA_FLYING_HEIGHT) >
            PA_FLYING_HEIGHT_THRESHOLD)
         {
-          vz= PA_FLYING_HEIGHT > m_current_height_from_guidance ?
+          vz= PA_FLYING_HEIGHT > m_estimate.height ?
                   PA_FLYING_Z_VELOCITY :
                   -PA_FLYING_Z_VELOCITY;
         }
@@ -2025,10 +2063,10 @@ void RMChallengeFSM::calculateZVelocity(float &vz)
       /*lower at bridge*/
       else
       {
-        if(fabs(m_current_height_from_guidance - PA_FLYING_HEIGHT_LOW) >
+        if(fabs(m_estimate.height - PA_FLYING_HEIGHT_LOW) >
            PA_FLYING_HEIGHT_THRESHOLD)
         {
-          vz= PA_FLYING_HEIGHT_LOW > m_current_height_from_guidance ?
+          vz= PA_FLYING_HEIGHT_LOW > m_estimate.height ?
                   PA_FLYING_Z_VELOCITY :
                   -PA_FLYING_Z_VELOCITY;
         }
@@ -2040,10 +2078,10 @@ void RMChallengeFSM::calculateZVelocity(float &vz)
 
     default:
     {
-      if(fabs(m_current_height_from_guidance - PA_FLYING_HEIGHT) >
+      if(fabs(m_estimate.height - PA_FLYING_HEIGHT) >
          PA_FLYING_HEIGHT_THRESHOLD)
       {
-        vz= PA_FLYING_HEIGHT > m_current_height_from_guidance ?
+        vz= PA_FLYING_HEIGHT > m_estimate.height ?
                 PA_FLYING_Z_VELOCITY :
                 -PA_FLYING_Z_VELOCITY;
       }
@@ -2081,12 +2119,12 @@ void RMChallengeFSM::updateVisionTask()
 
 void RMChallengeFSM::updateTPosition()
 {
-  m_T_position_x= m_real_position[0];
+  m_T_position_x= m_estimate.position[0];
 }
 
 bool RMChallengeFSM::forwardFarEnough()
 {
-  if((m_real_position[0] - m_T_position_x) > PA_FORWARD_THRESHOLD)
+  if((m_estimate.position[0] - m_T_position_x) > PA_FORWARD_THRESHOLD)
     return true;
   else
     return false;
@@ -2102,7 +2140,7 @@ bool RMChallengeFSM::isQulifying()
 
 bool RMChallengeFSM::backwardFarEnough()
 {
-  if((m_T_position_x - m_real_position[0]) > PA_FORWARD_THRESHOLD)
+  if((m_T_position_x - m_estimate.position[0]) > PA_FORWARD_THRESHOLD)
     return true;
   else
     return false;
@@ -2124,12 +2162,12 @@ void RMChallengeFSM::navigateByQRCode(float &vx, float &vy, float &vz,
 */
   if(m_base_state == BASE_POSITION)
   {
-    ROS_INFO("base position");
+    ROS_INFO_THROTTLE(PA_LOG_PERIOD, "base position");
     yaw= 0;
-    if(fabs(m_current_height_from_guidance - PA_BASE_HEIGHT) >
+    if(fabs(m_estimate.height - PA_BASE_HEIGHT) >
        PA_BASE_HEIGHT_THRESHOLD)
     {
-      vz= PA_BASE_HEIGHT > m_current_height_from_guidance ?
+      vz= PA_BASE_HEIGHT > m_estimate.height ?
               PA_FLYING_Z_VELOCITY :
               -PA_FLYING_Z_VELOCITY;
     }
@@ -2137,16 +2175,16 @@ void RMChallengeFSM::navigateByQRCode(float &vx, float &vy, float &vz,
     {
       vz= 0;
     }
-    vx= -PA_KP_BASE * m_base_position_error[0];
-    vy= -PA_KP_BASE * m_base_position_error[1];
+    vx= -PA_KP_BASE * m_estimate.base_error[0];
+    vy= -PA_KP_BASE * m_estimate.base_error[1];
     vx= fabs(vx) < PA_BASE_MIN_V ? (fabs(vx) / (vx + 0.00001)) * PA_BASE_MIN_V :
                                    vx;
     vy= fabs(vy) < PA_BASE_MIN_V ? (fabs(vy) / (vy + 0.00001)) * PA_BASE_MIN_V :
                                    vy;
 
     /*adjust angle error when pos error small*/
-    float pos_error= sqrt(pow(m_base_position_error[0], 2) +
-                          pow(m_base_position_error[1], 2));
+    float pos_error= sqrt(pow(m_estimate.base_error[0], 2) +
+                          pow(m_estimate.base_error[1], 2));
     if(pos_error < PA_BASE_POSITION_THRESHOLD)
     {
       m_base_state= BASE_ANGLE;
@@ -2154,9 +2192,10 @@ void RMChallengeFSM::navigateByQRCode(float &vx, float &vy, float &vz,
   }
   else if(m_base_state == BASE_ANGLE)
   {
-    ROS_INFO("base angle");
+    ROS_INFO_THROTTLE(PA_LOG_PERIOD, "base angle");
     vx= vy= vz= 0;
-    yaw= -PA_BASE_YAW_RATE * (fabs(m_base_angle) / (m_base_angle + 0.000001));
+    yaw= -PA_BASE_YAW_RATE * (fabs(m_estimate.base_angle) /
+                              (m_estimate.base_angle + 0.000001));
   }
 }
 
@@ -2171,8 +2210,8 @@ void RMChallengeFSM::publishPosition()
   geometry_msgs::Vector3Stamped pos;
   pos.header.frame_id= "position";
   pos.header.stamp= ros::Time::now();
-  pos.vector.x= m_real_position[0];
-  pos.vector.y= m_real_position[1];
+  pos.vector.x= m_estimate.position[0];
+  pos.vector.y= m_estimate.position[1];
   pos.vector.z= 0.0;
   m_position_pub.publish(pos);
 }
@@ -0,0 +1,36 @@
+#include "rm_challenge_image_mailbox.h"
+
+#include <chrono>
+
+ImageMailbox::ImageMailbox() : m_dropped(0)
+{
+}
+
+void ImageMailbox::post(const cv_bridge::CvImageConstPtr& image)
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+    if(m_image)
+      m_dropped++;
+    m_image= image;
+  }
+  m_cv.notify_one();
+}
+
+bool ImageMailbox::take(cv_bridge::CvImageConstPtr& image, double timeout)
+{
+  unique_lock<mutex> lock(m_mutex);
+  if(!m_cv.wait_for(lock, chrono::duration<double>(timeout),
+                    [this] { return (bool)m_image; }))
+    return false;
+  /*the slot is empty again until the next post*/
+  image= m_image;
+  m_image.reset();
+  return true;
+}
+
+unsigned long ImageMailbox::getDroppedCount()
+{
+  lock_guard<mutex> lock(m_mutex);
+  return m_dropped;
+}
@@ -0,0 +1,82 @@
+#include "rm_challenge_image_publisher.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <sensor_msgs/image_encodings.h>
+
+ImagePublisher::ImagePublisher() : m_max_rate(0), m_scale(1.0), m_gray(false)
+{
+}
+
+void ImagePublisher::advertise(ros::NodeHandle& node,
+                               ros::NodeHandle& config_node,
+                               const string& topic)
+{
+  config_node.param(topic + "/max_rate", m_max_rate, 0.0);
+  config_node.param(topic + "/scale", m_scale, 1.0);
+  config_node.param(topic + "/gray", m_gray, false);
+  image_transport::ImageTransport image_transport(node);
+  m_pub= image_transport.advertise(topic, 1);
+}
+
+bool ImagePublisher::publish(const cv::Mat& frame, const ros::Time& stamp)
+{
+  if(m_pub.getNumSubscribers() == 0)
+    return false;
+  ros::WallTime now= ros::WallTime::now();
+  if(m_max_rate > 0 && (now - m_last_time).toSec() < 1.0 / m_max_rate)
+    return false;
+  m_last_time= now;
+
+  cv::Size size= frame.size();
+  if(m_scale != 1.0)
+    size= cv::Size(cvRound(frame.cols * m_scale),
+                   cvRound(frame.rows * m_scale));
+  int type= m_gray ? CV_8UC1 : CV_8UC3;
+
+  /*convert straight into the message data, it is the only copy*/
+  sensor_msgs::ImagePtr msg(new sensor_msgs::Image);
+  msg->header.stamp= stamp;
+  msg->height= size.height;
+  msg->width= size.width;
+  msg->encoding= m_gray ? sensor_msgs::image_encodings::MONO8 :
+                          sensor_msgs::image_encodings::BGR8;
+  msg->is_bigendian= false;
+  msg->step= size.width * CV_ELEM_SIZE(type);
+  msg->data.resize(msg->step * size.height);
+  cv::Mat view(size, type, &msg->data[0], msg->step);
+
+  if(frame.type() == CV_8UC2)
+  {
+    /*yuyv of the v4l2 capture, gray is just its y channel*/
+    int code= m_gray ? CV_YUV2GRAY_YUY2 : CV_YUV2BGR_YUY2;
+    if(m_scale == 1.0)
+      cv::cvtColor(frame, view, code);
+    else
+    {
+      cv::cvtColor(frame, m_small, code);
+      cv::resize(m_small, view, size, 0, 0, cv::INTER_AREA);
+    }
+    m_pub.publish(msg);
+    return true;
+  }
+
+  const cv::Mat* src= &frame;
+  if(m_scale != 1.0)
+  {
+    if(m_gray)
+    {
+      /*shrink first, less to convert*/
+      cv::resize(frame, m_small, size, 0, 0, cv::INTER_AREA);
+      src= &m_small;
+    }
+    else
+      cv::resize(frame, view, size, 0, 0, cv::INTER_AREA);
+  }
+  if(m_gray)
+    cv::cvtColor(*src, view, CV_BGR2GRAY);
+  else if(m_scale == 1.0)
+    frame.copyTo(view);
+
+  m_pub.publish(msg);
+  return true;
+}
@@ -0,0 +1,101 @@
+#include "rm_challenge_latency_tracer.h"
+
+#include <algorithm>
+#include <sstream>
+
+static float percentile(const vector<float>& sorted, float p)
+{
+  int i= (int)(p * (sorted.size() - 1) + 0.5);
+  return sorted[i];
+}
+
+LatencyTracer::LatencyTracer(int window) : m_window(window)
+{
+}
+
+void LatencyTracer::advertise(ros::NodeHandle& node, const string& topic,
+                              double period)
+{
+  m_pub= node.advertise<test2::LatencyReport>(topic, 1);
+  m_timer= node.createTimer(ros::Duration(period),
+                            &LatencyTracer::publishCallback, this);
+}
+
+void LatencyTracer::record(const string& stage, const ros::Time& capture_stamp)
+{
+  if(capture_stamp.isZero())
+    return;
+  addSample(stage, (ros::Time::now() - capture_stamp).toSec() * 1000.0);
+}
+
+void LatencyTracer::addSample(const string& stage, double ms)
+{
+  lock_guard<mutex> lock(m_mutex);
+  STAGE& s= findStage(stage);
+  if((int)s.samples.size() < m_window)
+    s.samples.push_back(ms);
+  else
+    s.samples[s.next]= ms;
+  s.next= (s.next + 1) % m_window;
+  s.count++;
+}
+
+LatencyTracer::STAGE& LatencyTracer::findStage(const string& name)
+{
+  /*few stages, in the order they were first recorded*/
+  for(int i= 0; i < (int)m_stages.size(); i++)
+    if(m_stages[i].name == name)
+      return m_stages[i];
+  STAGE stage;
+  stage.name= name;
+  stage.next= 0;
+  stage.count= 0;
+  stage.samples.reserve(m_window);
+  m_stages.push_back(stage);
+  return m_stages.back();
+}
+
+void LatencyTracer::fillReport(test2::LatencyReport& report)
+{
+  report.header.stamp= ros::Time::now();
+  report.stage.clear();
+  report.count.clear();
+  report.p50_ms.clear();
+  report.p95_ms.clear();
+  report.p99_ms.clear();
+  report.max_ms.clear();
+  vector<float> sorted;
+  lock_guard<mutex> lock(m_mutex);
+  for(int i= 0; i < (int)m_stages.size(); i++)
+  {
+    if(m_stages[i].samples.empty())
+      continue;
+    sorted= m_stages[i].samples;
+    sort(sorted.begin(), sorted.end());
+    report.stage.push_back(m_stages[i].name);
+    report.count.push_back(m_stages[i].count);
+    report.p50_ms.push_back(percentile(sorted, 0.50));
+    report.p95_ms.push_back(percentile(sorted, 0.95));
+    report.p99_ms.push_back(percentile(sorted, 0.99));
+    report.max_ms.push_back(sorted.back());
+  }
+}
+
+string LatencyTracer::reportString()
+{
+  test2::LatencyReport report;
+  fillReport(report);
+  stringstream ss;
+  ss.precision(3);
+  for(int i= 0; i < (int)report.stage.size(); i++)
+    ss << (i ? ", " : "") << report.stage[i] << " " << report.p50_ms[i] << "/"
+       << report.p95_ms[i] << "/" << report.p99_ms[i] << "ms";
+  return ss.str();
+}
+
+void LatencyTracer::publishCallback(const ros::TimerEvent& evt)
+{
+  test2::LatencyReportPtr report(new test2::LatencyReport);
+  fillReport(*report);
+  m_pub.publish(report);
+}
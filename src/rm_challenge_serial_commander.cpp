@@ -0,0 +1,155 @@
+#include "rm_challenge_serial_commander.h"
+
+#include <ros/console.h>
+
+SerialCommander::SerialCommander(int repeat, double retry_period)
+  : m_repeat(repeat)
+  , m_retry_period(chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(retry_period)))
+  , m_port(m_io_service)
+  , m_running(false)
+  , m_written(0)
+  , m_coalesced(0)
+  , m_failed(0)
+{
+  for(int i= 0; i < SERIAL_CHANNEL_NUM; i++)
+  {
+    m_commands[i].byte= 0;
+    m_commands[i].valid= false;
+    m_commands[i].left= 0;
+  }
+}
+
+SerialCommander::~SerialCommander()
+{
+  close();
+}
+
+bool SerialCommander::open(const string& device, int baud_rate)
+{
+  using boost::asio::serial_port;
+  close();
+  boost::system::error_code err_code;
+  m_port.open(device, err_code);
+  if(err_code)
+  {
+    ROS_ERROR_STREAM("can't open " << device << ": " << err_code.message());
+    return false;
+  }
+  m_port.set_option(serial_port::baud_rate(baud_rate), err_code);
+  m_port.set_option(
+      serial_port::flow_control(serial_port::flow_control::none), err_code);
+  m_port.set_option(serial_port::parity(serial_port::parity::none),
+                    err_code);
+  m_port.set_option(serial_port::stop_bits(serial_port::stop_bits::one),
+                    err_code);
+  m_port.set_option(serial_port::character_size(8), err_code);
+
+  m_written= 0;
+  m_coalesced= 0;
+  m_failed= 0;
+  m_running= true;
+  m_thread= thread(&SerialCommander::writeLoop, this);
+  return true;
+}
+
+void SerialCommander::close()
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_running= false;
+  }
+  m_cv.notify_one();
+  if(m_thread.joinable())
+    m_thread.join();
+  if(m_port.is_open())
+  {
+    boost::system::error_code err_code;
+    m_port.close(err_code);
+  }
+}
+
+void SerialCommander::send(SERIAL_CHANNEL channel, char command)
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+    COMMAND& c= m_commands[channel];
+    /*the same command is still being written*/
+    if(c.valid && c.left > 0 && c.byte == command)
+    {
+      m_coalesced++;
+      return;
+    }
+    /*a different command replaces the writes left of the old one*/
+    if(c.valid && c.left > 0)
+      m_coalesced++;
+    /*all writes done, the device may have lost every one of them, so
+     * the same command again is written again*/
+    c.byte= command;
+    c.valid= true;
+    c.left= m_repeat;
+    c.next= chrono::steady_clock::now();
+  }
+  m_cv.notify_one();
+}
+
+void SerialCommander::writeLoop()
+{
+  unique_lock<mutex> lock(m_mutex);
+  while(m_running)
+  {
+    /*earliest write due over all channels*/
+    int due= -1;
+    for(int i= 0; i < SERIAL_CHANNEL_NUM; i++)
+    {
+      if(m_commands[i].left > 0 &&
+         (due < 0 || m_commands[i].next < m_commands[due].next))
+        due= i;
+    }
+    if(due < 0)
+    {
+      m_cv.wait(lock);
+      continue;
+    }
+    if(chrono::steady_clock::now() < m_commands[due].next)
+    {
+      /*woken early by a new command or close*/
+      m_cv.wait_until(lock, m_commands[due].next);
+      continue;
+    }
+
+    COMMAND& c= m_commands[due];
+    char byte= c.byte;
+    c.left--;
+    c.next= chrono::steady_clock::now() + m_retry_period;
+
+    /*send() may go on while the byte is on the line*/
+    lock.unlock();
+    boost::system::error_code err_code;
+    boost::asio::write(m_port, boost::asio::buffer(&byte, 1), err_code);
+    if(err_code)
+    {
+      m_failed++;
+      ROS_WARN_STREAM_THROTTLE(1.0, "serial write failed: "
+                                        << err_code.message());
+    }
+    else
+      m_written++;
+    lock.lock();
+  }
+}
+
+unsigned long SerialCommander::getWrittenCount() const
+{
+  return m_written;
+}
+
+unsigned long SerialCommander::getCoalescedCount() const
+{
+  return m_coalesced;
+}
+
+unsigned long SerialCommander::getFailedCount() const
+{
+  return m_failed;
+}
@@ -0,0 +1,251 @@
+#include "rm_challenge_state_estimator.h"
+
+#include <stddef.h>
+
+AlphaBetaFilter::AlphaBetaFilter(float alpha, float beta)
+  : m_alpha(alpha)
+  , m_beta(beta)
+  , m_valid(false)
+  , m_stamp(0)
+  , m_value(0)
+  , m_rate(0)
+{
+}
+
+void AlphaBetaFilter::update(double stamp, float value)
+{
+  double dt= stamp - m_stamp;
+  if(!m_valid || dt > PA_ESTIMATOR_MAX_GAP)
+  {
+    reset(stamp, value);
+    return;
+  }
+  /*out of order, the newer one already counted*/
+  if(dt < 0)
+    return;
+  float predicted= m_value + m_rate * dt;
+  float innovation= value - predicted;
+  m_value= predicted + m_alpha * innovation;
+  /*same stamp twice only moves the value*/
+  if(dt > 0)
+    m_rate+= m_beta * innovation / dt;
+  m_stamp= stamp;
+}
+
+void AlphaBetaFilter::reset(double stamp, float value)
+{
+  m_valid= true;
+  m_stamp= stamp;
+  m_value= value;
+  m_rate= 0;
+}
+
+float AlphaBetaFilter::predict(double stamp) const
+{
+  double dt= stamp - m_stamp;
+  if(dt < 0)
+    dt= 0;
+  if(dt > PA_ESTIMATOR_MAX_PREDICT)
+    dt= PA_ESTIMATOR_MAX_PREDICT;
+  return m_value + m_rate * dt;
+}
+
+bool AlphaBetaFilter::isValid() const
+{
+  return m_valid;
+}
+
+double AlphaBetaFilter::getStamp() const
+{
+  return m_stamp;
+}
+
+float AlphaBetaFilter::getRate() const
+{
+  return m_rate;
+}
+
+StateEstimator::StateEstimator()
+  : m_height(PA_ESTIMATOR_HEIGHT_ALPHA, PA_ESTIMATOR_HEIGHT_BETA)
+  , m_height_head(0)
+  , m_height_num(0)
+  , m_circle_found(false)
+  , m_circle_height(0)
+  , m_arc_found(false)
+  , m_base_found(false)
+  , m_base_angle(0)
+{
+  for(int i= 0; i < 2; i++)
+  {
+    m_position[i]= AlphaBetaFilter(PA_ESTIMATOR_POSITION_ALPHA,
+                                   PA_ESTIMATOR_POSITION_BETA);
+    m_circle[i]= AlphaBetaFilter(PA_ESTIMATOR_VISION_ALPHA,
+                                 PA_ESTIMATOR_VISION_BETA);
+    m_arc[i]= AlphaBetaFilter(PA_ESTIMATOR_VISION_ALPHA,
+                              PA_ESTIMATOR_VISION_BETA);
+    m_base[i]= AlphaBetaFilter(PA_ESTIMATOR_VISION_ALPHA,
+                               PA_ESTIMATOR_VISION_BETA);
+    m_raw_position[i]= 0;
+    m_bias[i]= 0;
+  }
+}
+
+void StateEstimator::updateGuidancePosition(double stamp, float x, float y,
+                                            bool on_land)
+{
+  float raw[2]= { x, y };
+  for(int i= 0; i < 2; i++)
+  {
+    m_raw_position[i]= raw[i];
+    if(on_land)
+    {
+      /*raw = real + bias, the real position does not move on land*/
+      float real= m_position[i].predict(stamp);
+      m_bias[i]= raw[i] - real;
+      m_position[i].reset(stamp, real);
+    }
+    else
+    {
+      m_position[i].update(stamp, raw[i] - m_bias[i]);
+    }
+  }
+}
+
+void StateEstimator::updateHeight(double stamp, float height)
+{
+  m_height.update(stamp, height);
+  /*an out of order measurement did not move the filter*/
+  if(m_height.getStamp() != stamp)
+    return;
+  HEIGHT_SAMPLE sample= { stamp, m_height.predict(stamp) };
+  int newest= (m_height_head + m_height_num - 1) % PA_ESTIMATOR_HEIGHT_HISTORY;
+  /*same stamp twice only moves the value*/
+  if(m_height_num > 0 && m_height_history[newest].stamp == stamp)
+  {
+    m_height_history[newest]= sample;
+    return;
+  }
+  /*full, drop the oldest*/
+  if(m_height_num == PA_ESTIMATOR_HEIGHT_HISTORY)
+  {
+    m_height_head= (m_height_head + 1) % PA_ESTIMATOR_HEIGHT_HISTORY;
+    m_height_num--;
+  }
+  m_height_history[(m_height_head + m_height_num) %
+                   PA_ESTIMATOR_HEIGHT_HISTORY]= sample;
+  m_height_num++;
+}
+
+void StateEstimator::updateCircle(double stamp, bool found, float error_x,
+                                  float error_y, float height)
+{
+  m_circle_found= found;
+  m_circle_height= found ? height : 0;
+  updateTarget(m_circle, stamp, found, error_x, error_y);
+}
+
+void StateEstimator::updateArc(double stamp, bool found, float error_x,
+                               float error_y)
+{
+  m_arc_found= found;
+  updateTarget(m_arc, stamp, found, error_x, error_y);
+}
+
+void StateEstimator::updateBase(double stamp, bool found, float error_x,
+                                float error_y, float angle)
+{
+  m_base_found= found;
+  m_base_angle= found ? angle : 0;
+  updateTarget(m_base, stamp, found, error_x, error_y);
+}
+
+void StateEstimator::updateTarget(AlphaBetaFilter* filter, double stamp,
+                                  bool found, float error_x, float error_y)
+{
+  float error[2]= { error_x, error_y };
+  for(int i= 0; i < 2; i++)
+  {
+    /*a target found again starts without the rate it was lost with*/
+    if(found)
+      filter[i].update(stamp, error[i]);
+    else
+      filter[i].reset(stamp, 0);
+  }
+}
+
+void StateEstimator::setPosition(float x, float y)
+{
+  float position[2]= { x, y };
+  for(int i= 0; i < 2; i++)
+  {
+    m_position[i].reset(m_position[i].getStamp(), position[i]);
+    m_bias[i]= m_raw_position[i] - position[i];
+  }
+}
+
+void StateEstimator::resetVision()
+{
+  m_circle_found= false;
+  m_arc_found= false;
+  m_base_found= false;
+}
+
+float StateEstimator::getHeightAt(double stamp) const
+{
+  if(m_height_num == 0 || stamp >= m_height.getStamp())
+    return m_height.predict(stamp);
+  /*newest to oldest, until the first sample not after stamp*/
+  const HEIGHT_SAMPLE* after= NULL;
+  for(int i= m_height_num - 1; i >= 0; i--)
+  {
+    const HEIGHT_SAMPLE& sample=
+        m_height_history[(m_height_head + i) % PA_ESTIMATOR_HEIGHT_HISTORY];
+    if(sample.stamp <= stamp)
+    {
+      if(after == NULL)
+        return sample.height;
+      float k= (stamp - sample.stamp) / (after->stamp - sample.stamp);
+      return sample.height + k * (after->height - sample.height);
+    }
+    after= &sample;
+  }
+  /*older than the history*/
+  return after->height;
+}
+
+const float* StateEstimator::getGuidanceBias() const
+{
+  return m_bias;
+}
+
+void StateEstimator::predictTarget(const AlphaBetaFilter* filter,
+                                   double stamp, bool& found,
+                                   float error[2]) const
+{
+  if(found && stamp - filter[0].getStamp() > PA_ESTIMATOR_VISION_TIMEOUT)
+    found= false;
+  for(int i= 0; i < 2; i++)
+    error[i]= found ? filter[i].predict(stamp) : 0;
+}
+
+void StateEstimator::predict(double stamp, UAV_ESTIMATE& estimate) const
+{
+  estimate.stamp= stamp;
+  for(int i= 0; i < 2; i++)
+  {
+    estimate.position[i]= m_position[i].predict(stamp);
+    estimate.velocity[i]= m_position[i].getRate();
+  }
+  estimate.height= m_height.predict(stamp);
+  estimate.height_rate= m_height.getRate();
+
+  estimate.circle_found= m_circle_found;
+  predictTarget(m_circle, stamp, estimate.circle_found,
+                estimate.circle_error);
+  estimate.circle_height= estimate.circle_found ? m_circle_height : 0;
+  estimate.arc_found= m_arc_found;
+  predictTarget(m_arc, stamp, estimate.arc_found, estimate.arc_error);
+  estimate.base_found= m_base_found;
+  predictTarget(m_base, stamp, estimate.base_found, estimate.base_error);
+  estimate.base_angle= estimate.base_found ? m_base_angle : 0;
+}
@@ -5,6 +5,8 @@
 #include <geometry_msgs/Twist.h>
 #include <geometry_msgs/Vector3Stamped.h>
 #include <image_transport/image_transport.h>
+#include <ros/callback_queue.h>
+#include <ros/file_log.h>
 #include <sensor_msgs/LaserScan.h>
 #include <sensor_msgs/image_encodings.h>
 #include <std_msgs/Empty.h>
@@ -15,21 +17,23 @@
 // my file
 #include "rm_challenge_fsm.h"
 
+#include <atomic>
+
 #if CURRENT_COMPUTER == MANIFOLD
 dji_sdk::RCChannels g_rc_channels;
 void rc_channels_callback(const dji_sdk::RCChannels rc_channels);
 #endif
 
 RMChallengeFSM g_fsm;
-bool is_F_mode= true;
+std::atomic<bool> is_F_mode(true);
 
 void uav_state_callback(const std_msgs::UInt8::ConstPtr &msg);
 void guidance_distance_callback(const sensor_msgs::LaserScan &g_oa);
 void guidance_position_callback(const geometry_msgs::Vector3Stamped &g_pos);
 // void ultrasonic_callback(const sensor_msgs::LaserScan& g_ul) ;
-void vision_pillar_callback(const std_msgs::String::ConstPtr &msg);
-void vision_base_callback(const std_msgs::String::ConstPtr &msg);
-void vision_line_callback(const std_msgs::String::ConstPtr &msg);
+void vision_pillar_callback(const test2::PillarResult::ConstPtr &msg);
+void vision_base_callback(const test2::BaseResult::ConstPtr &msg);
+void vision_line_callback(const test2::LineResult::ConstPtr &msg);
 /**timer callback, control uav in a finite state machine*/
 void timer_callback(const ros::TimerEvent &evt);
 
@@ -37,6 +41,14 @@ int main(int argc, char **argv)
 {
   ros::init(argc, argv, "rm_uav_challenge");
   ros::NodeHandle node;
+  /*per tick state goes to the event log, decoded by rm_event_log_decode*/
+  ros::NodeHandle private_node("~");
+  std::string event_file;
+  private_node.param<std::string>(
+      "event_log", event_file,
+      ros::file_log::getLogDirectory() + "/uav_events.bin");
+  if(!g_event_log.open(event_file))
+    ROS_WARN_STREAM("can't open event log " << event_file);
 /*subscriber from dji node*/
 #if CURRENT_COMPUTER == MANIFOLD
   ros::Subscriber rc_channels_sub=
@@ -58,7 +70,12 @@ int main(int argc, char **argv)
       node.subscribe("tpp/base", 1, vision_base_callback);
   ros::Subscriber vision_line_sub=
       node.subscribe("tpp/yellow_line", 1, vision_line_callback);
-  ros::Timer timer= node.createTimer(ros::Duration(1.0 / 50.0), timer_callback);
+  /*the control timer has a queue and a thread of its own, so it runs on
+   * time behind bursts of sensor messages. The sensor callbacks only
+   * store their input, see RMChallengeFSM::applyInputs*/
+  ros::CallbackQueue control_queue;
+  ros::Timer timer= node.createTimer(ros::TimerOptions(
+      ros::Duration(1.0 / 50.0), timer_callback, &control_queue));
 
   /*initialize fsm*/
   g_fsm.setPositionFromGuidance(5.2, -2);  // TEST
@@ -111,7 +128,10 @@ int main(int argc, char **argv)
   // g_fsm.setLineVariables( dis, nor );
   //    ros::Duration( 2.0 ).sleep();
   /*test*/
+  ros::AsyncSpinner control_spinner(1, &control_queue);
+  control_spinner.start();
   ros::spin();
+  control_spinner.stop();
   return 0;
 }
 
@@ -143,24 +163,14 @@ void uav_state_callback(const std_msgs::UInt8::ConstPtr &msg)
 
 void guidance_distance_callback(const sensor_msgs::LaserScan &g_oa)
 {
-  ROS_INFO("frame_id: %s stamp: %d\n", g_oa.header.frame_id.c_str(),
-           g_oa.header.stamp.sec);
-  ROS_INFO("obstacle distance: [%f %f %f %f %f]\n", g_oa.ranges[0],
-           g_oa.ranges[1], g_oa.ranges[2], g_oa.ranges[3], g_oa.ranges[4]);
-  g_fsm.setHeightFromGuidance(g_oa.ranges[0]);
+  g_fsm.setHeightFromGuidance(g_oa.ranges[0], g_oa.header.stamp);
 }
 
 void guidance_position_callback(const geometry_msgs::Vector3Stamped &g_pos)
 {
-  ROS_INFO("frame_id: %s stamp: %d\n", g_pos.header.frame_id.c_str(),
-           g_pos.header.stamp.sec);
-  g_fsm.setPositionFromGuidance(g_pos.vector.x, g_pos.vector.y);
-
-  /*test guidance*/
-  float pos_x = g_pos.vector.x;
-  float pos_y = g_pos.vector.y;
-  g_fsm.transformCoordinate(PA_COORDINATE_TRANSFORM_ANGLE,pos_x,pos_y);
-  ROS_INFO_STREAM("position is :"<<pos_x<<","<<pos_y);
+  /*the transformed position is in the event log*/
+  g_fsm.setPositionFromGuidance(g_pos.vector.x, g_pos.vector.y,
+                                g_pos.header.stamp);
 }
 
 // void ultrasonic_callback(const sensor_msgs::LaserScan& g_ul) {
@@ -173,41 +183,19 @@ void guidance_position_callback(const geometry_msgs::Vector3Stamped &g_pos)
 //            (int)g_ul.intensities[i]);
 // }
 
-void vision_pillar_callback(const std_msgs::String::ConstPtr &msg)
+void vision_pillar_callback(const test2::PillarResult::ConstPtr &msg)
 {
-  float h;
-  float circle_pos[2];
-  float arc_pos[2];
-  int tri[4];
-  bool circle_found, arc_found;
-  std::stringstream ss(msg->data.c_str());
-  ss >> tri[0] >> tri[1] >> tri[2] >> tri[3] >> circle_found >> circle_pos[1] >>
-      circle_pos[0] >> h >> arc_pos[1] >> arc_pos[0] >> arc_found;
-  g_fsm.setCircleVariables(circle_found, circle_pos, h);
-  g_fsm.setTriangleVariables(tri);
-  // height not used,set to 0
-  g_fsm.setArcVariables(arc_found, arc_pos);
+  g_fsm.setPillarResult(*msg);
 }
 
-void vision_base_callback(const std_msgs::String::ConstPtr &msg)
+void vision_base_callback(const test2::BaseResult::ConstPtr &msg)
 {
-  float pos[2], base_angle;
-  bool base_found;
-  std::stringstream ss(msg->data.c_str());
-  ss >> base_found >> pos[0] >> pos[1] >> base_angle;
-
-  g_fsm.setBaseVariables(base_found, pos, base_angle);
+  g_fsm.setBaseResult(*msg);
 }
 
-void vision_line_callback(const std_msgs::String::ConstPtr &msg)
+void vision_line_callback(const test2::LineResult::ConstPtr &msg)
 {
-  std::stringstream ss(msg->data.c_str());
-  bool is_T_found;
-  float line_normal[2];
-  float dist_to_line[2];
-  ss >> is_T_found >> dist_to_line[0] >> dist_to_line[1] >> line_normal[0] >>
-      line_normal[1];
-  g_fsm.setLineVariables(is_T_found, dist_to_line, line_normal);
+  g_fsm.setLineResult(*msg);
 }
 
 void timer_callback(const ros::TimerEvent &evt)
@@ -220,6 +208,6 @@ void timer_callback(const ros::TimerEvent &evt)
   {
     /*not F mode, need to reset fsm*/
     g_fsm.resetAllState();
-    ROS_INFO("Wait for F mode");
+    ROS_INFO_THROTTLE(1.0, "Wait for F mode");
   }
 }
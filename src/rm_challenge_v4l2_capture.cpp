@@ -0,0 +1,217 @@
+#include "rm_challenge_v4l2_capture.h"
+
+#include <ros/console.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chrono>
+
+/*the frame grabber holds up to three, the driver needs the others to
+ * keep capturing*/
+#define V4L2_BUFFER_NUM 6
+
+static int xioctl(int fd, unsigned long request, void* arg)
+{
+  int r;
+  do
+    r= ioctl(fd, request, arg);
+  while(r < 0 && errno == EINTR);
+  return r;
+}
+
+V4L2Capture::V4L2Capture() : m_fd(-1), m_width(0), m_height(0)
+{
+}
+
+V4L2Capture::~V4L2Capture()
+{
+  close();
+}
+
+bool V4L2Capture::open(const string& device, int width, int height,
+                       double fps, int exposure, int gain)
+{
+  close();
+  m_fd= ::open(device.c_str(), O_RDWR | O_NONBLOCK);
+  if(m_fd < 0)
+  {
+    ROS_ERROR_STREAM("can't open " << device << ": " << strerror(errno));
+    return false;
+  }
+
+  struct v4l2_format format;
+  memset(&format, 0, sizeof(format));
+  format.type= V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  format.fmt.pix.width= width;
+  format.fmt.pix.height= height;
+  format.fmt.pix.pixelformat= V4L2_PIX_FMT_YUYV;
+  format.fmt.pix.field= V4L2_FIELD_NONE;
+  if(xioctl(m_fd, VIDIOC_S_FMT, &format) < 0 ||
+     format.fmt.pix.pixelformat != V4L2_PIX_FMT_YUYV ||
+     format.fmt.pix.bytesperline != format.fmt.pix.width * 2)
+  {
+    ROS_ERROR_STREAM(device << " has no packed yuyv format");
+    close();
+    return false;
+  }
+  m_width= format.fmt.pix.width;
+  m_height= format.fmt.pix.height;
+  if(m_width != width || m_height != height)
+    ROS_WARN_STREAM(device << " captures " << m_width << "x" << m_height
+                           << " instead of " << width << "x" << height);
+
+  struct v4l2_streamparm param;
+  memset(&param, 0, sizeof(param));
+  param.type= V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  param.parm.capture.timeperframe.numerator= 1000;
+  param.parm.capture.timeperframe.denominator= (int)(fps * 1000);
+  if(xioctl(m_fd, VIDIOC_S_PARM, &param) < 0)
+    ROS_WARN_STREAM(device << " frame rate not set");
+
+  if(exposure >= 0)
+  {
+    /*manual exposure, and the frame rate must not drop to expose longer*/
+    if(!setControl(V4L2_CID_EXPOSURE_AUTO, V4L2_EXPOSURE_MANUAL) ||
+       !setControl(V4L2_CID_EXPOSURE_ABSOLUTE, exposure))
+      ROS_WARN_STREAM(device << " exposure not set");
+    setControl(V4L2_CID_EXPOSURE_AUTO_PRIORITY, 0);
+  }
+  if(gain >= 0)
+  {
+    setControl(V4L2_CID_AUTOGAIN, 0);
+    if(!setControl(V4L2_CID_GAIN, gain))
+      ROS_WARN_STREAM(device << " gain not set");
+  }
+
+  struct v4l2_requestbuffers request;
+  memset(&request, 0, sizeof(request));
+  request.count= V4L2_BUFFER_NUM;
+  request.type= V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  request.memory= V4L2_MEMORY_MMAP;
+  if(xioctl(m_fd, VIDIOC_REQBUFS, &request) < 0 || request.count < 4)
+  {
+    ROS_ERROR_STREAM(device << " has no mmap streaming buffers");
+    close();
+    return false;
+  }
+  for(int i= 0; i < (int)request.count; i++)
+  {
+    struct v4l2_buffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.type= V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory= V4L2_MEMORY_MMAP;
+    buffer.index= i;
+    if(xioctl(m_fd, VIDIOC_QUERYBUF, &buffer) < 0)
+    {
+      close();
+      return false;
+    }
+    void* data= mmap(NULL, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     m_fd, buffer.m.offset);
+    if(data == MAP_FAILED)
+    {
+      close();
+      return false;
+    }
+    m_buffers.push_back(data);
+    m_lengths.push_back(buffer.length);
+    release(i);
+  }
+
+  enum v4l2_buf_type type= V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if(xioctl(m_fd, VIDIOC_STREAMON, &type) < 0)
+  {
+    ROS_ERROR_STREAM(device << " does not stream: " << strerror(errno));
+    close();
+    return false;
+  }
+  return true;
+}
+
+void V4L2Capture::close()
+{
+  if(m_fd < 0)
+    return;
+  enum v4l2_buf_type type= V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  xioctl(m_fd, VIDIOC_STREAMOFF, &type);
+  for(int i= 0; i < (int)m_buffers.size(); i++)
+    munmap(m_buffers[i], m_lengths[i]);
+  m_buffers.clear();
+  m_lengths.clear();
+  ::close(m_fd);
+  m_fd= -1;
+}
+
+bool V4L2Capture::isOpened() const
+{
+  return m_fd >= 0;
+}
+
+bool V4L2Capture::dequeue(int& index, cv::Mat& frame, double& stamp,
+                          double timeout)
+{
+  struct pollfd fd;
+  fd.fd= m_fd;
+  fd.events= POLLIN;
+  fd.revents= 0;
+  if(poll(&fd, 1, (int)(timeout * 1000)) <= 0)
+    return false;
+
+  struct v4l2_buffer buffer;
+  memset(&buffer, 0, sizeof(buffer));
+  buffer.type= V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buffer.memory= V4L2_MEMORY_MMAP;
+  if(xioctl(m_fd, VIDIOC_DQBUF, &buffer) < 0)
+    return false;
+  index= buffer.index;
+  frame= cv::Mat(m_height, m_width, CV_8UC2, m_buffers[index]);
+
+  /*the driver stamps on the monotonic clock, move it to the wall clock of
+   * the ros stamps*/
+  double now= chrono::duration<double>(
+                  chrono::system_clock::now().time_since_epoch())
+                  .count();
+  double age= 0;
+  if(buffer.flags & V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+  {
+    struct timespec mono;
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    age= mono.tv_sec + mono.tv_nsec * 1e-9 -
+         (buffer.timestamp.tv_sec + buffer.timestamp.tv_usec * 1e-6);
+    if(age < 0 || age > 1.0)
+      age= 0;
+  }
+  stamp= now - age;
+  return true;
+}
+
+void V4L2Capture::release(int index)
+{
+  struct v4l2_buffer buffer;
+  memset(&buffer, 0, sizeof(buffer));
+  buffer.type= V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buffer.memory= V4L2_MEMORY_MMAP;
+  buffer.index= index;
+  xioctl(m_fd, VIDIOC_QBUF, &buffer);
+}
+
+cv::Size V4L2Capture::getSize() const
+{
+  return cv::Size(m_width, m_height);
+}
+
+bool V4L2Capture::setControl(int id, int value)
+{
+  struct v4l2_control control;
+  control.id= id;
+  control.value= value;
+  return xioctl(m_fd, VIDIOC_S_CTRL, &control) == 0;
+}
@@ -0,0 +1,127 @@
+#include "rm_challenge_video_recorder.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+VideoRecorder::VideoRecorder(int queue_size)
+  : m_slots(queue_size)
+  , m_head(0)
+  , m_count(0)
+  , m_max_count(0)
+  , m_stop(false)
+  , m_written(0)
+  , m_dropped(0)
+{
+}
+
+VideoRecorder::~VideoRecorder()
+{
+  close();
+}
+
+bool VideoRecorder::open(const string& file_name, int fourcc, double fps,
+                         cv::Size size)
+{
+  close();
+  if(!m_writer.open(file_name, fourcc, fps, size))
+    return false;
+  m_head= m_count= m_max_count= 0;
+  m_written= m_dropped= 0;
+  m_stop= false;
+  m_thread= thread(&VideoRecorder::encodeLoop, this);
+  return true;
+}
+
+void VideoRecorder::close()
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_stop= true;
+  }
+  m_cv.notify_all();
+  if(m_thread.joinable())
+    m_thread.join();
+  m_writer.release();
+}
+
+bool VideoRecorder::isOpened() const
+{
+  return m_writer.isOpened();
+}
+
+bool VideoRecorder::write(const cv::Mat& frame)
+{
+  int slot;
+  {
+    lock_guard<mutex> lock(m_mutex);
+    if(!m_thread.joinable())
+      return false;
+    if(m_count == (int)m_slots.size())
+    {
+      m_dropped++;
+      return false;
+    }
+    slot= (m_head + m_count) % m_slots.size();
+  }
+  /*the slot is not used by the encoding thread until it is counted, the
+   * copy reuses its buffer*/
+  frame.copyTo(m_slots[slot]);
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_count++;
+    if(m_count > m_max_count)
+      m_max_count= m_count;
+  }
+  m_cv.notify_one();
+  return true;
+}
+
+void VideoRecorder::encodeLoop()
+{
+  unique_lock<mutex> lock(m_mutex);
+  while(true)
+  {
+    m_cv.wait(lock, [this] { return m_stop || m_count > 0; });
+    /*the frames queued before close are still written*/
+    if(m_count == 0)
+      return;
+    int slot= m_head;
+    lock.unlock();
+    /*yuyv frames of the v4l2 capture are converted here, not by the
+     * caller*/
+    if(m_slots[slot].type() == CV_8UC2)
+    {
+      cv::cvtColor(m_slots[slot], m_bgr, CV_YUV2BGR_YUY2);
+      m_writer.write(m_bgr);
+    }
+    else
+      m_writer.write(m_slots[slot]);
+    lock.lock();
+    m_head= (m_head + 1) % m_slots.size();
+    m_count--;
+    m_written++;
+  }
+}
+
+int VideoRecorder::getBacklog()
+{
+  lock_guard<mutex> lock(m_mutex);
+  return m_count;
+}
+
+int VideoRecorder::getMaxBacklog()
+{
+  lock_guard<mutex> lock(m_mutex);
+  return m_max_count;
+}
+
+unsigned long VideoRecorder::getWrittenCount()
+{
+  lock_guard<mutex> lock(m_mutex);
+  return m_written;
+}
+
+unsigned long VideoRecorder::getDroppedCount()
+{
+  lock_guard<mutex> lock(m_mutex);
+  return m_dropped;
+}
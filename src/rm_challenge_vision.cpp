@@ -3,6 +3,7 @@
 RMChallengeVision::RMChallengeVision(bool visable)
 {
   m_visable= visable;
+  initColorLut();
 }
 
 void RMChallengeVision::setVisability(bool visable)
@@ -10,75 +11,409 @@ void RMChallengeVision::setVisability(bool visable)
   m_visable= visable;
 }
 
+/*division tables of the 8 bit BGR2HSV conversion, same as opencv*/
+static const int HSV_SHIFT= 12;
+struct HsvDivTable
+{
+  int sdiv[256];
+  int hdiv[256];      /*hue in 0-180*/
+  int hdiv_full[256]; /*hue in 0-255*/
+  HsvDivTable()
+  {
+    sdiv[0]= hdiv[0]= hdiv_full[0]= 0;
+    for(int i= 1; i < 256; i++)
+    {
+      sdiv[i]= cvRound((255 << HSV_SHIFT) / (1. * i));
+      hdiv[i]= cvRound((180 << HSV_SHIFT) / (6. * i));
+      hdiv_full[i]= cvRound((256 << HSV_SHIFT) / (6. * i));
+    }
+  }
+};
+static const HsvDivTable g_hsv_div;
+
+/*************************************************
+Function:       fusedColorMask
+Description:    单次遍历完成颜色分割，等价于
+                cvtColor(HSV) + equalizeHist(V) + inRange +
+                两个通道差阈值 + bitwise_and
+Input:          bgr: 已模糊的BGR图像
+                c1,c2,c3: 主通道与两个比较通道的下标
+                thresh1,thresh2: c1-c2, c1-c3 的阈值
+                hsv_low,hsv_high: HSV范围
+Output:         mask: 二值结果
+Others:         通道差测试先做，大部分像素在此被拒绝，只有通过的像素才
+                计算H和S; V只有在范围不是0-255时才需要均衡化，
+                此时额外做一次直方图得到与equalizeHist相同的LUT
+*************************************************/
+static void fusedColorMask(const Mat& bgr, int c1, int c2, int c3,
+                           int thresh1, int thresh2, const int hsv_low[3],
+                           const int hsv_high[3], Mat& mask)
+{
+  mask.create(bgr.size(), CV_8UC1);
+  const int rows= bgr.rows, cols= bgr.cols;
+  const bool check_h= hsv_low[0] > 0 || hsv_high[0] < 180;
+  const bool check_s= hsv_low[1] > 0 || hsv_high[1] < 255;
+  const bool check_v= hsv_low[2] > 0 || hsv_high[2] < 255;
+  const int t1= thresh1 > 0 ? thresh1 : 0;
+  const int t2= thresh2 > 0 ? thresh2 : 0;
+
+  /*V pass LUT, identity unless V range is narrowed*/
+  uchar v_pass[256];
+  for(int i= 0; i < 256; i++)
+    v_pass[i]= 1;
+  if(check_v)
+  {
+    int hist[256]= { 0 };
+    for(int i= 0; i < rows; i++)
+    {
+      const uchar* p= bgr.ptr<uchar>(i);
+      for(int j= 0; j < cols; j++, p+= 3)
+        hist[std::max(p[0], std::max(p[1], p[2]))]++;
+    }
+    int first= 0;
+    while(first < 255 && !hist[first])
+      first++;
+    int total= rows * cols;
+    uchar lut[256]= { 0 };
+    if(hist[first] == total)
+    {
+      for(int i= 0; i < 256; i++)
+        lut[i]= (uchar)first;
+    }
+    else
+    {
+      float scale= 255.f / (total - hist[first]);
+      int sum= 0;
+      for(int i= first + 1; i < 256; i++)
+      {
+        sum+= hist[i];
+        lut[i]= saturate_cast<uchar>(sum * scale);
+      }
+    }
+    for(int i= 0; i < 256; i++)
+      v_pass[i]= lut[i] >= hsv_low[2] && lut[i] <= hsv_high[2];
+  }
+
+  for(int i= 0; i < rows; i++)
+  {
+    const uchar* p= bgr.ptr<uchar>(i);
+    uchar* m= mask.ptr<uchar>(i);
+    for(int j= 0; j < cols; j++, p+= 3)
+    {
+      int a= p[c1];
+      /*c1>c2 && |c1-c2|>t is c1-c2>t for t>=0*/
+      bool pass= (a - p[c2] > t1) & (a - p[c3] > t2);
+      if(pass)
+      {
+        int b= p[0], g= p[1], r= p[2];
+        int v= std::max(b, std::max(g, r));
+        int vmin= std::min(b, std::min(g, r));
+        int diff= v - vmin;
+        pass= v_pass[v];
+        if(pass && check_s)
+        {
+          int sat= (diff * g_hsv_div.sdiv[v] + (1 << (HSV_SHIFT - 1))) >>
+                   HSV_SHIFT;
+          pass= sat >= hsv_low[1] && sat <= hsv_high[1];
+        }
+        if(pass && check_h)
+        {
+          int h;
+          if(v == r)
+            h= g - b;
+          else if(v == g)
+            h= b - r + 2 * diff;
+          else
+            h= r - g + 4 * diff;
+          h= (h * g_hsv_div.hdiv[diff] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+          h+= h < 0 ? 180 : 0;
+          pass= h >= hsv_low[0] && h <= hsv_high[0];
+        }
+      }
+      m[j]= pass ? 255 : 0;
+    }
+  }
+}
+
+/*layout of the parameters of a color class in the lookup table*/
+enum
+{
+  PILLAR_C1= 0,
+  PILLAR_C2,
+  PILLAR_C3,
+  PILLAR_T1,
+  PILLAR_T2,
+  PILLAR_LOW_H,
+  PILLAR_LOW_S,
+  PILLAR_LOW_V,
+  PILLAR_HIGH_H,
+  PILLAR_HIGH_S,
+  PILLAR_HIGH_V
+};
+enum
+{
+  YELLOW_LOW_H= 0,
+  YELLOW_HIGH_H,
+  YELLOW_S,
+  YELLOW_V
+};
+
+/*mask kernels used to fill the lookup table, both read params as above*/
+static void pillarColorKernel(const Mat& bgr, const int params[], Mat& mask)
+{
+  fusedColorMask(bgr, params[PILLAR_C1], params[PILLAR_C2], params[PILLAR_C3],
+                 params[PILLAR_T1], params[PILLAR_T2], params + PILLAR_LOW_H,
+                 params + PILLAR_HIGH_H, mask);
+}
+
+/*same tests as getYellowRegion: HSV_FULL h in range, s and v above
+ * threshold, g-b>27, r-b>27, |r-g|<=35*/
+static void yellowColorKernel(const Mat& bgr, const int params[], Mat& mask)
+{
+  mask.create(bgr.size(), CV_8UC1);
+  for(int i= 0; i < bgr.rows; i++)
+  {
+    const uchar* p= bgr.ptr<uchar>(i);
+    uchar* m= mask.ptr<uchar>(i);
+    for(int j= 0; j < bgr.cols; j++, p+= 3)
+    {
+      int b= p[0], g= p[1], r= p[2];
+      bool pass= g - b > 27 && r - b > 27 && std::abs(r - g) <= 35;
+      if(pass)
+      {
+        int v= std::max(b, std::max(g, r));
+        int vmin= std::min(b, std::min(g, r));
+        int diff= v - vmin;
+        int sat= (diff * g_hsv_div.sdiv[v] + (1 << (HSV_SHIFT - 1))) >>
+                 HSV_SHIFT;
+        int h;
+        if(v == r)
+          h= g - b;
+        else if(v == g)
+          h= b - r + 2 * diff;
+        else
+          h= r - g + 4 * diff;
+        h= (h * g_hsv_div.hdiv_full[diff] + (1 << (HSV_SHIFT - 1))) >>
+           HSV_SHIFT;
+        h+= h < 0 ? 256 : 0;
+        h= std::min(h, 255);
+        pass= h >= params[YELLOW_LOW_H] && h <= params[YELLOW_HIGH_H] &&
+              sat > params[YELLOW_S] && v > params[YELLOW_V];
+      }
+      m[j]= pass ? 255 : 0;
+    }
+  }
+}
+
+vector<uchar> RMChallengeVision::s_color_lut;
+int RMChallengeVision::s_lut_params[LUT_CLASS_NUM][LUT_PARAM_NUM];
+int RMChallengeVision::s_lut_class_num= 0;
+
+/*thresholds of extractColor per COLOR_TYPE: low h, high h, low s,
+ * high s, low v, high v, bgr threshold 1 and 2*/
+enum
+{
+  COLOR_LOW_H= 0,
+  COLOR_HIGH_H,
+  COLOR_LOW_S,
+  COLOR_HIGH_S,
+  COLOR_LOW_V,
+  COLOR_HIGH_V,
+  COLOR_T1,
+  COLOR_T2,
+  COLOR_THRESHOLD_NUM
+};
+static const int g_color_thresholds[3][COLOR_THRESHOLD_NUM]= {
+  { 0, 210, 0, 255, 0, 255, 40, 30 },   /*RED*/
+  { 49, 155, 0, 255, 0, 255, 20, 20 },  /*GREEN*/
+  { 49, 155, 0, 255, 0, 255, 5, 35 },   /*BLUE*/
+};
+
+/*yellow thresholds of getYellowRegion: the defaults, detectLine and
+ * detectLineWithT*/
+static const int g_yellow_thresholds[][4]= {
+  { 30, 75, 80, 80 },
+  { 30, 47, 150, 90 },
+  { 30, 53, 99, 140 },
+};
+
+/*parameters of pillarColorKernel for a COLOR_TYPE and its thresholds*/
+static void pillarColorParams(int color, const int thresholds[],
+                              int params[])
+{
+  /*main channel first, then the two channels it is compared with*/
+  static const int channels[3][3]= { { 2, 1, 0 }, { 1, 0, 2 }, { 0, 1, 2 } };
+  params[PILLAR_C1]= channels[color][0];
+  params[PILLAR_C2]= channels[color][1];
+  params[PILLAR_C3]= channels[color][2];
+  params[PILLAR_T1]= thresholds[COLOR_T1];
+  params[PILLAR_T2]= thresholds[COLOR_T2];
+  params[PILLAR_LOW_H]= thresholds[COLOR_LOW_H];
+  params[PILLAR_LOW_S]= thresholds[COLOR_LOW_S];
+  params[PILLAR_LOW_V]= thresholds[COLOR_LOW_V];
+  params[PILLAR_HIGH_H]= thresholds[COLOR_HIGH_H];
+  params[PILLAR_HIGH_S]= thresholds[COLOR_HIGH_S];
+  params[PILLAR_HIGH_V]= thresholds[COLOR_HIGH_V];
+}
+
+/*************************************************
+Function:       initColorLut
+Description:    建立所有实例共用的查找表，只在第一次调用时建立
+Output:         s_color_lut
+Others:         在构造函数中调用，飞行中不再重建表
+*************************************************/
+void RMChallengeVision::initColorLut()
+{
+  static once_flag once;
+  call_once(once, []() {
+    s_color_lut.assign(1 << 24, 0);
+    for(int color= RED; color <= BLUE; color++)
+    {
+      int params[LUT_PARAM_NUM];
+      pillarColorParams(color, g_color_thresholds[color], params);
+      addColorLut(params, pillarColorKernel);
+    }
+    for(const int* yellow : g_yellow_thresholds)
+    {
+      int params[LUT_PARAM_NUM]= { yellow[0], yellow[1], yellow[2],
+                                   yellow[3] };
+      addColorLut(params, yellowColorKernel);
+    }
+  });
+}
+
+/*************************************************
+Function:       addColorLut
+Description:    在查找表中加入一个颜色类别
+Input:          params: 类别的阈值
+                kernel: 判断颜色的函数
+Output:         s_color_lut
+Others:         表的下标为(b<<16)|(g<<8)|r，每个类别占一位，
+                按b分块把所有颜色送进kernel，结果与kernel完全一致
+*************************************************/
+void RMChallengeVision::addColorLut(const int params[], MaskKernel kernel)
+{
+  if(s_lut_class_num >= LUT_CLASS_NUM)
+    return;
+  int bit= s_lut_class_num;
+  Mat block(256, 256, CV_8UC3), mask;
+  for(int g= 0; g < 256; g++)
+  {
+    uchar* p= block.ptr<uchar>(g);
+    for(int r= 0; r < 256; r++, p+= 3)
+    {
+      p[1]= g;
+      p[2]= r;
+    }
+  }
+  const uchar set= 1 << bit;
+  for(int b= 0; b < 256; b++)
+  {
+    for(int g= 0; g < 256; g++)
+    {
+      uchar* p= block.ptr<uchar>(g);
+      for(int r= 0; r < 256; r++, p+= 3)
+        p[0]= b;
+    }
+    kernel(block, params, mask);
+    uchar* lut= &s_color_lut[b << 16];
+    const uchar* m= mask.ptr<uchar>(0);
+    for(int i= 0; i < 1 << 16; i++)
+    {
+      if(m[i])
+        lut[i]|= set;
+    }
+  }
+  std::copy(params, params + LUT_PARAM_NUM, s_lut_params[bit]);
+  s_lut_class_num++;
+}
+
+/*************************************************
+Function:       findColorLut
+Description:    找到阈值相同的颜色类别
+Input:          params: 类别的阈值
+Return:         类别在表中的位，没有时为-1
+*************************************************/
+int RMChallengeVision::findColorLut(const int params[])
+{
+  for(int bit= 0; bit < s_lut_class_num; bit++)
+  {
+    if(std::equal(params, params + LUT_PARAM_NUM, s_lut_params[bit]))
+      return bit;
+  }
+  return -1;
+}
+
+/*************************************************
+Function:       applyColorLut
+Description:    查表得到一个颜色类别的二值图，每个像素只访问一次表
+Input:          src: BGR图像
+                bit: 类别在表中的位
+Output:         dst: 二值结果
+*************************************************/
+void RMChallengeVision::applyColorLut(const Mat& src, int bit, Mat& dst)
+{
+  dst.create(src.size(), CV_8UC1);
+  const uchar* lut= &s_color_lut[0];
+  const uchar set= 1 << bit;
+  for(int i= 0; i < src.rows; i++)
+  {
+    const uchar* p= src.ptr<uchar>(i);
+    uchar* m= dst.ptr<uchar>(i);
+    for(int j= 0; j < src.cols; j++, p+= 3)
+      m[j]= (lut[(p[0] << 16) | (p[1] << 8) | p[2]] & set) ? 255 : 0;
+  }
+}
+
 /*************************************************
 Function:       extractColor
 Description:    提取指定颜色的区域k
 Input:              src:     源图像
                 color：选定的颜色
 Output:             colorRegion: 提取的颜色区域
-Others:
+Others:         模糊图像与结果都缓存在frame中，同一帧只计算一次
 *************************************************/
 void RMChallengeVision::extractColor(Mat src, COLOR_TYPE color,
                                      Mat& colorRegion)
 {
+  FrameContext frame(src);
+  extractColor(frame, color, colorRegion);
+}
+void RMChallengeVision::extractColor(FrameContext& frame, COLOR_TYPE color,
+                                     Mat& colorRegion)
+{
+  const Mat& src= frame.bgr();
   if(src.channels() != 3)
     return;
+  std::stringstream key;
+  key << "color " << color;
+  if(frame.findMask(key.str(), colorRegion))
+    return;
+  /*never write into a mask that may be cached for another key*/
+  colorRegion.release();
   /*preprocessing*/
-  Mat temp= src.clone();
-  GaussianBlur(temp, temp, Size(5, 5), 0, 0);
-  /*to hsv color space*/
-  Mat hsv;
-  vector<Mat> hsvSplit;
-  cvtColor(temp, hsv, CV_BGR2HSV);
-  split(hsv, hsvSplit);
-  equalizeHist(hsvSplit[2], hsvSplit[2]);
-  merge(hsvSplit, hsv);
-
-  static int iLowH; /*threshold of  hue*/
-  static int iHighH;
-  static int iLowS; /*threshold of saturation*/
-  static int iHighS;
-  static int iLowV; /*threshold of value*/
-  static int iHighV;
-  static int bgrThresh1; /*threshold of r-g g-r b-g ... depending on
-                            the
-                            color*/
-  static int bgrThresh2; /*threshold of r-b g-r b-g...depending on the
-                            color*/
-
-  if(color == RED)
-  {
-    iLowH= 0;
-    iHighH= 210;
-    iLowS= 0;
-    iHighS= 255;
-    iLowV= 0;
-    iHighV= 255;
-    bgrThresh1= 40;
-    bgrThresh2= 30;
-  }
-  else if(color == BLUE)
-  {
-    iLowH= 49;
-    iHighH= 155;
-    iLowS= 0;
-    iHighS= 255;
-    iLowV= 0;
-    iHighV= 255;
-    bgrThresh1= 5;
-    bgrThresh2= 35;
-  }
-  else if(color == GREEN)
-  {
-    iLowH= 49;
-    iHighH= 155;
-    iLowS= 0;
-    iHighS= 255;
-    iLowV= 0;
-    iHighV= 255;
-    bgrThresh1= 20;
-    bgrThresh2= 20;
-  }
+  const Mat& temp= frame.blurred();
+
+  int& iLowH= m_low_h; /*threshold of  hue*/
+  int& iHighH= m_high_h;
+  int& iLowS= m_low_s; /*threshold of saturation*/
+  int& iHighS= m_high_s;
+  int& iLowV= m_low_v; /*threshold of value*/
+  int& iHighV= m_high_v;
+  int& bgrThresh1= m_bgr_thresh1; /*threshold of r-g g-r b-g ... depending
+                                     on the color*/
+  int& bgrThresh2= m_bgr_thresh2; /*threshold of r-b g-r b-g...depending on
+                                     the color*/
+
+  const int* thresholds= g_color_thresholds[color];
+  iLowH= thresholds[COLOR_LOW_H];
+  iHighH= thresholds[COLOR_HIGH_H];
+  iLowS= thresholds[COLOR_LOW_S];
+  iHighS= thresholds[COLOR_HIGH_S];
+  iLowV= thresholds[COLOR_LOW_V];
+  iHighV= thresholds[COLOR_HIGH_V];
+  bgrThresh1= thresholds[COLOR_T1];
+  bgrThresh2= thresholds[COLOR_T2];
 
   /*Create a gui to control color threshold*/
   if(m_visable)
@@ -96,46 +431,21 @@ void RMChallengeVision::extractColor(Mat src, COLOR_TYPE color,
     cvCreateTrackbar("rg", "Control", &bgrThresh1, 255);
     cvCreateTrackbar("rb", "Control", &bgrThresh2, 255);
   }
-  /*extract region with needed hsv*/
-  inRange(hsv, Scalar(iLowH, iLowS, iLowV), Scalar(iHighH, iHighS, iHighV),
-          hsv);
-  vector<Mat> bgrSplit;
-  split(temp, bgrSplit);
-  Mat bgr1, bgr2, bgr3;
-  if(color == RED)
-  {
-    bgr1= bgrSplit.at(2);
-    bgr2= bgrSplit.at(1);
-    bgr3= bgrSplit.at(0);
-  }
-  else if(color == BLUE)
-  {
-    bgr1= bgrSplit.at(0);
-    bgr2= bgrSplit.at(1);
-    bgr3= bgrSplit.at(2);
-  }
-  else if(color == GREEN)
-  {
-    bgr1= bgrSplit.at(1);
-    bgr2= bgrSplit.at(0);
-    bgr3= bgrSplit.at(2);
-  }
-  /*extract region that r>b and |r-b|>threshold */
-  Mat large, /*r larger than b or g*/
-      abs,   /*|r-b or g|>threshold */
-      region1, region2;
-  cv::compare(bgr1, bgr2, large, CMP_GT);
-  cv::absdiff(bgr1, bgr2, abs);
-  cv::threshold(abs, abs, bgrThresh1, 255, THRESH_BINARY);
-  cv::bitwise_and(large, abs, region1);
-  /*extract region that r>g and |r-g|>threshold */
-  cv::compare(bgr1, bgr3, large, CMP_GT);
-  cv::absdiff(bgr1, bgr3, abs);
-  cv::threshold(abs, abs, bgrThresh2, 255, THRESH_BINARY);
-  cv::bitwise_and(large, abs, region2);
-  /*all region merge together*/
-  cv::bitwise_and(region1, region2, colorRegion);
-  cv::bitwise_and(colorRegion, hsv, colorRegion);
+  /*the trackbars may have changed the thresholds*/
+  int current[COLOR_THRESHOLD_NUM]= { iLowH, iHighH, iLowS,      iHighS,
+                                      iLowV, iHighV, bgrThresh1, bgrThresh2 };
+  int params[LUT_PARAM_NUM];
+  pillarColorParams(color, current, params);
+  /*v equalization depends on the whole image, a narrowed v range is never
+   * in the table*/
+  int bit= findColorLut(params);
+  if(bit >= 0)
+    applyColorLut(temp, bit, colorRegion);
+  else
+    fusedColorMask(temp, params[PILLAR_C1], params[PILLAR_C2],
+                   params[PILLAR_C3], params[PILLAR_T1], params[PILLAR_T2],
+                   params + PILLAR_LOW_H, params + PILLAR_HIGH_H, colorRegion);
+  frame.storeMask(key.str(), colorRegion);
   if(m_visable)
   {
     if(color == RED)
@@ -181,11 +491,185 @@ Others:             只有当已知物体实际尺寸时可用
 *************************************************/
 float RMChallengeVision::imageToHeight(float imageLength, float realLength)
 {
-  static float f= 507.8; /*camera parameter*/
+  const float f= 507.8; /*camera parameter*/
   float realHeight= (realLength / (imageLength + 0.00001)) * f;
   return realHeight / 1000;
 }
 
+/*************************************************
+Function:       labelBlobs
+Description:    一次两遍扫描标记连通域，同时统计每个连通域的面积、
+                包围盒、质心和一、二阶矩，代替findContours加
+                contourArea的做法
+Input:          mask: 二值图
+                value: 要标记的像素值，255为前景，0为背景(孔洞)
+                eight_connected: 8连通或4连通
+Output:         labels: CV_32S, 0为未标记，连通域i的标号为i+1
+                blobs: 每个连通域的统计量
+*************************************************/
+void RMChallengeVision::labelBlobs(const Mat& mask, uchar value,
+                                   bool eight_connected, Mat& labels,
+                                   vector<BLOB_STAT>& blobs)
+{
+  const int rows= mask.rows, cols= mask.cols;
+  labels.create(mask.size(), CV_32S);
+  blobs.clear();
+  /// 并查集，parent[0]不用
+  vector<int> parent(1, 0);
+  for(int i= 0; i < rows; i++)
+  {
+    const uchar* m= mask.ptr<uchar>(i);
+    int* l= labels.ptr<int>(i);
+    const int* up= i > 0 ? labels.ptr<int>(i - 1) : NULL;
+    for(int j= 0; j < cols; j++)
+    {
+      if(m[j] != value)
+      {
+        l[j]= 0;
+        continue;
+      }
+      int neighbor[4]= { j > 0 ? l[j - 1] : 0, up ? up[j] : 0, 0, 0 };
+      if(eight_connected && up)
+      {
+        neighbor[2]= j > 0 ? up[j - 1] : 0;
+        neighbor[3]= j < cols - 1 ? up[j + 1] : 0;
+      }
+      int root= 0;
+      for(int k= 0; k < 4; k++)
+      {
+        int n= neighbor[k];
+        if(!n)
+          continue;
+        while(parent[n] != n)
+          n= parent[n];
+        if(!root)
+          root= n;
+        else if(n != root)
+        {
+          /// 合并到较小的根
+          if(n < root)
+            std::swap(n, root);
+          parent[n]= root;
+        }
+      }
+      if(!root)
+      {
+        root= (int)parent.size();
+        parent.push_back(root);
+      }
+      l[j]= root;
+    }
+  }
+  /// 压缩成连续标号
+  vector<int> final_label(parent.size(), 0);
+  int blob_cnt= 0;
+  for(int n= 1; n < (int)parent.size(); n++)
+  {
+    int r= n;
+    while(parent[r] != r)
+      r= parent[r];
+    if(r == n)
+      final_label[n]= ++blob_cnt;
+    else
+      final_label[n]= final_label[r];
+  }
+  BLOB_STAT empty= { 0, Rect(cols, rows, 0, 0), Point2f(0, 0), 0, 0, 0, 0, 0,
+                     false };
+  blobs.assign(blob_cnt, empty);
+  vector<Point> br(blob_cnt, Point(-1, -1));
+  for(int i= 0; i < rows; i++)
+  {
+    int* l= labels.ptr<int>(i);
+    for(int j= 0; j < cols; j++)
+    {
+      if(!l[j])
+        continue;
+      int id= final_label[l[j]];
+      l[j]= id;
+      BLOB_STAT& b= blobs[id - 1];
+      b.area++;
+      b.m10+= j;
+      b.m01+= i;
+      b.m20+= j * j;
+      b.m11+= j * i;
+      b.m02+= i * i;
+      b.bbox.x= std::min(b.bbox.x, j);
+      b.bbox.y= std::min(b.bbox.y, i);
+      br[id - 1].x= std::max(br[id - 1].x, j);
+      br[id - 1].y= std::max(br[id - 1].y, i);
+    }
+  }
+  for(int k= 0; k < blob_cnt; k++)
+  {
+    BLOB_STAT& b= blobs[k];
+    b.bbox.width= br[k].x - b.bbox.x + 1;
+    b.bbox.height= br[k].y - b.bbox.y + 1;
+    b.centroid= Point2f((float)b.m10 / b.area, (float)b.m01 / b.area);
+    b.touch_border= b.bbox.x == 0 || b.bbox.y == 0 || br[k].x == cols - 1 ||
+                    br[k].y == rows - 1;
+  }
+}
+
+/*************************************************
+Function:       removeSmallBlobs
+Description:    去除面积小于min_area的连通域
+Input:          mask: 二值图
+                min_area: 最小面积
+Output:         mask: 去除小连通域后的二值图
+                kept: 保留下来的连通域的统计量
+*************************************************/
+void RMChallengeVision::removeSmallBlobs(Mat& mask, int min_area,
+                                         vector<BLOB_STAT>& kept)
+{
+  Mat labels;
+  vector<BLOB_STAT> blobs;
+  labelBlobs(mask, 255, true, labels, blobs);
+  vector<uchar> keep(blobs.size() + 1, 0);
+  kept.clear();
+  for(int k= 0; k < (int)blobs.size(); k++)
+  {
+    if(blobs[k].area >= min_area)
+    {
+      keep[k + 1]= 1;
+      kept.push_back(blobs[k]);
+    }
+  }
+  for(int i= 0; i < mask.rows; i++)
+  {
+    uchar* m= mask.ptr<uchar>(i);
+    const int* l= labels.ptr<int>(i);
+    for(int j= 0; j < mask.cols; j++)
+    {
+      if(m[j] && !keep[l[j]])
+        m[j]= 0;
+    }
+  }
+}
+
+/*************************************************
+Function:       traceBlob
+Description:    只对一个连通域在其包围盒内提取外轮廓
+Input:          labels: labelBlobs得到的标号图
+                id: 连通域标号
+                bbox: 连通域包围盒
+Output:         contour: 图像坐标下的外轮廓
+*************************************************/
+static void traceBlob(const Mat& labels, int id, const Rect& bbox,
+                      vector<Point>& contour)
+{
+  Mat blob= labels(bbox) == id;
+  vector<vector<Point> > contours;
+  cv::findContours(blob, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE,
+                   bbox.tl());
+  contour.clear();
+  /// 包围盒内只有这个连通域，取最长的轮廓
+  for(int i= 0; i < (int)contours.size(); i++)
+  {
+    if(contours[i].size() > contour.size())
+      contour.swap(contours[i]);
+  }
+}
+
 void RMChallengeVision::detectTriangle(Mat src, Mat color_region,
                                        int triangle[4])
 {
@@ -198,7 +682,27 @@ void RMChallengeVision::detectTriangle(Mat src, Mat color_region,
   Mat element= getStructuringElement(MORPH_ELLIPSE, Size(3, 3));
   erode(temp, temp, element);
 
-  cv::findContours(temp, contours, CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE);
+  // triangles may be colored blobs or holes in the colored region, screen
+  // both by their stats and only trace the candidates
+  Mat fg_labels, hole_labels;
+  vector<BLOB_STAT> fg_blobs, hole_blobs;
+  labelBlobs(temp, 255, true, fg_labels, fg_blobs);
+  labelBlobs(temp, 0, false, hole_labels, hole_blobs);
+  for(int k= 0; k < (int)fg_blobs.size() + (int)hole_blobs.size(); k++)
+  {
+    bool is_hole= k >= (int)fg_blobs.size();
+    int id= is_hole ? k - (int)fg_blobs.size() : k;
+    const BLOB_STAT& blob= is_hole ? hole_blobs[id] : fg_blobs[id];
+    if(is_hole && blob.touch_border)
+      continue;
+    // a 45 45 90 triangle fills 0.41-0.5 of its bounding box
+    float fill= (float)blob.area / blob.bbox.area();
+    if(blob.area < 70 || fill < 0.3 || fill > 0.75)
+      continue;
+    contours.push_back(vector<Point>());
+    traceBlob(is_hole ? hole_labels : fg_labels, id + 1, blob.bbox,
+              contours.back());
+  }
   vector<vector<Point> > triangles;
   for(int k= 0; k < 4; k++)
     triangle[k]= 0;
@@ -313,9 +817,19 @@ void RMChallengeVision::detectPillarCircle(Mat src, Mat color_region,
 {
   circle_found= false;
   vector<vector<Point> > contours;
-  Mat temp;
-  color_region.copyTo(temp);
-  cv::findContours(temp, contours, CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE);
+  // screen blobs by their stats, a blob filling more than 0.8 of its
+  // enclosing circle fills more than 0.6 of its bounding box
+  Mat labels;
+  vector<BLOB_STAT> blobs;
+  labelBlobs(color_region, 255, true, labels, blobs);
+  for(int k= 0; k < (int)blobs.size(); k++)
+  {
+    if(blobs[k].area <= 900 ||
+       blobs[k].area < 0.6 * blobs[k].bbox.area())
+      continue;
+    contours.push_back(vector<Point>());
+    traceBlob(labels, k + 1, blobs[k].bbox, contours.back());
+  }
   // find circle in all contours
   vector<float> radiuses;
   Mat draw= src.clone();
@@ -406,19 +920,24 @@ void RMChallengeVision::detectPillarCircle(Mat src, Mat color_region,
   }
 }
 
-void RMChallengeVision::detectPillarArc(Mat src, Mat color_region,
+void RMChallengeVision::detectPillarArc(FrameContext& frame, Mat color_region,
                                         bool& circle_found,
                                         Point2f& circle_center, float& radius)
 {
+  const Mat& src= frame.bgr();
   const static int MIN_RADIUS= 100, MAX_RADIUS= 450;
-  static float last_radius= MIN_RADIUS;
-  static Point2f last_center;
+  /// 两帧之间圆心在图像中的最大移动，以及半径的最大变化
+  const static int TRACK_SHIFT= 40, RADIUS_SHIFT= 30;
+  float& last_radius= m_arc_last_radius;
+  Point2f& last_center= m_arc_last_center;
+  /// 上一帧是否找到圆，以及霍夫圆心的图像坐标
+  bool& last_found= m_arc_last_found;
+  Point2f& last_hough_center= m_arc_last_hough_center;
 
   radius= last_radius;
   circle_center= last_center;
   circle_found= false;
 
-  Mat temp= src.clone();
   /// 扩展边缘
   int top= last_center.y + last_radius > src.rows / 2 ?
                (int)last_center.y + last_radius - src.rows / 2 :
@@ -432,26 +951,43 @@ void RMChallengeVision::detectPillarArc(Mat src, Mat color_region,
       right= last_center.x + last_radius > src.cols / 2 ?
                  (int)last_center.x + last_radius - src.cols / 2 :
                  0;
-  copyMakeBorder(src, src, top, bottom, left, right, BORDER_CONSTANT);
-  copyMakeBorder(color_region, color_region, top, bottom, left, right,
-                 BORDER_CONSTANT);
   //  cout<<top<<' ';
-  /// 原图像转换为灰度图像
-  Mat src_gray;
-  cvtColor(temp, src_gray, CV_BGR2GRAY);
-  /// 模糊
-  blur(src_gray, src_gray, Size(3, 3));
+  /// 灰度并模糊后的图像，与其他检测共用
+  const Mat& src_gray= frame.grayBlurred();
   /// 霍夫找圆
   vector<Vec3f> circles;
   double dp= 2, min_dist= 200, canny_thresh= 200, accumulator= last_radius / 2;
-  int min_radius= (int)last_radius - 50 > MIN_RADIUS ? (int)last_radius - 50 :
-                                                       MIN_RADIUS,
-      max_radius= (int)last_radius + 100 < MAX_RADIUS ? (int)last_radius + 100 :
-                                                        MAX_RADIUS;
-  min_radius= MIN_RADIUS;
-  max_radius= MAX_RADIUS;
-  HoughCircles(src_gray, circles, CV_HOUGH_GRADIENT, dp, min_dist, canny_thresh,
-               accumulator, min_radius, max_radius);
+  int min_radius= (int)last_radius - RADIUS_SHIFT > MIN_RADIUS ?
+                     (int)last_radius - RADIUS_SHIFT :
+                     MIN_RADIUS,
+      max_radius= (int)last_radius + RADIUS_SHIFT < MAX_RADIUS ?
+                      (int)last_radius + RADIUS_SHIFT :
+                      MAX_RADIUS;
+  /// 跟踪：上一帧找到圆时，只在上一个圆的圆环所在的窗口和半径范围内找
+  if(last_found)
+  {
+    int half= max_radius + TRACK_SHIFT;
+    Rect window((int)last_hough_center.x - half,
+                (int)last_hough_center.y - half, 2 * half, 2 * half);
+    window&= Rect(0, 0, src_gray.cols, src_gray.rows);
+    /// 窗口超过半幅图像时省不了多少，直接找整幅图像，跟丢时不用找两遍
+    if(window.area() > 0 && window.area() <= (int)src_gray.total() / 2)
+    {
+      HoughCircles(src_gray(window), circles, CV_HOUGH_GRADIENT, dp, min_dist,
+                   canny_thresh, accumulator, min_radius, max_radius);
+      for(int i= 0; i < (int)circles.size(); i++)
+      {
+        circles[i][0]+= window.x;
+        circles[i][1]+= window.y;
+      }
+    }
+  }
+  /// 跟丢了，在整幅图像和全部半径范围内找
+  if(circles.empty())
+  {
+    HoughCircles(src_gray, circles, CV_HOUGH_GRADIENT, dp, min_dist,
+                 canny_thresh, accumulator, MIN_RADIUS, MAX_RADIUS);
+  }
 
   float hough_radius;
   Point2f hough_center;
@@ -463,14 +999,17 @@ void RMChallengeVision::detectPillarArc(Mat src, Mat color_region,
     /// 霍夫半径
     hough_radius= circles[0][2];
     /// 返回值
-    circle_center.x= hough_center.x - (temp.cols - left - right) / 2 - left;
-    circle_center.y= (temp.rows - top - bottom) / 2 - hough_center.y + top;
+    circle_center.x= hough_center.x - (src.cols - left - right) / 2 - left;
+    circle_center.y= (src.rows - top - bottom) / 2 - hough_center.y + top;
     circle_found= true;
     last_center= circle_center;
     last_radius= hough_radius;
+    last_found= true;
+    last_hough_center= hough_center;
   }
   else
   {
+    last_found= false;
     return;
   }
   //  /// 已知圆心找最小圆
@@ -499,6 +1038,7 @@ void RMChallengeVision::detectPillarArc(Mat src, Mat color_region,
   {
     // if (circle_found)
     {
+      Mat temp= src.clone();
       Point pl(0, 240);
       Point pr(640, 240);
       Point pu(320, 0);
@@ -523,20 +1063,30 @@ void RMChallengeVision::detectPillarArc(Mat src, Mat color_region,
 int RMChallengeVision::detectPillar(Mat src, COLOR_TYPE color,
                                     PILLAR_RESULT& pillar_result)
 {
+  FrameContext frame(src);
+  return detectPillar(frame, color, pillar_result);
+}
+int RMChallengeVision::detectPillar(FrameContext& frame, COLOR_TYPE color,
+                                    PILLAR_RESULT& pillar_result)
+{
+  const Mat& src= frame.bgr();
   // first detect red pillar
   Mat color_region;
-  ROS_INFO("1");
-  extractColor(src, color, color_region);
-  ROS_INFO("2");
+  /*the stages in the event log show where a frame was stuck*/
+  g_event_log.log(EV_PILLAR_STAGE, 1);
+  extractColor(frame, color, color_region);
+  g_event_log.log(EV_PILLAR_STAGE, 2);
   detectPillarCircle(src, color_region, pillar_result.circle_found,
                      pillar_result.circle_center, pillar_result.radius);
-  ROS_INFO("3");
+  g_event_log.log(EV_PILLAR_STAGE, 3);
   detectTriangle(src, color_region, pillar_result.triangle);
-  ROS_INFO("4");
-  detectPillarArc(src, color_region, pillar_result.arc_found,
+  g_event_log.log(EV_PILLAR_STAGE, 4);
+  detectPillarArc(frame, color_region, pillar_result.arc_found,
                   pillar_result.arc_center, pillar_result.arc_radius);
 
-  ROS_INFO_STREAM("circle center is:" << pillar_result.circle_center);
+  g_event_log.log(EV_PILLAR_CIRCLE, pillar_result.circle_found,
+                  pillar_result.circle_center.x, pillar_result.circle_center.y,
+                  pillar_result.radius);
   return 1;
 
   int triangle_sum= pillar_result.triangle[0] + pillar_result.triangle[1] +
@@ -551,7 +1101,7 @@ int RMChallengeVision::detectPillar(Mat src, COLOR_TYPE color,
   else  // no red triangle found ,detect blue region instead
   {
     Mat blue_region;
-    extractColor(src, RMChallengeVision::BLUE, blue_region);
+    extractColor(frame, RMChallengeVision::BLUE, blue_region);
     detectTriangle(src, blue_region, pillar_result.triangle);
     triangle_sum= pillar_result.triangle[0] + pillar_result.triangle[1] +
                   pillar_result.triangle[2] + pillar_result.triangle[3];
@@ -594,61 +1144,28 @@ float RMChallengeVision::angle(Point pt1, Point pt2, Point pt0)
 void RMChallengeVision::getYellowRegion(Mat& src, Mat& dst, int LowH, int HighH,
                                         int sThreshold, int vThreshold)
 {
-  Mat hsv, Line_sv, hsvColorRegion;
-  vector<Mat> hsvSplit;
-  cvtColor(src, hsv, CV_BGR2HSV_FULL);  //转换成HSV
-  split(hsv, hsvSplit);  //分离出HSV通道，用于提取黄色区域
-  // threshold(hsvSplit[0], Line_h1, h_low, 255,
-  //          THRESH_BINARY);  //去除 H 小于 h_low 度的区域
-  // threshold(hsvSplit[0], Line_h2, h_high, 255,
-  //          THRESH_BINARY_INV);  //去除 H 大于 h_high 度的区域
-  inRange(hsvSplit[0], LowH, HighH, hsvSplit[0]);
-  threshold(hsvSplit[1], hsvSplit[1], sThreshold, 255,
-            THRESH_BINARY);  //去除 S 小于 s_threshold 的区域
-  threshold(hsvSplit[2], hsvSplit[2], vThreshold, 255,
-            THRESH_BINARY);  //去除 V 小于 v_threshold 的区域
-  // bitwise_and(Line_h1, Line_h2, Line_h);
-  bitwise_and(hsvSplit[1], hsvSplit[2], Line_sv);
-  bitwise_and(hsvSplit[0], Line_sv, hsvColorRegion);  //矩阵位与（255&255=255）
-  // Line_h = Line_h1 + Line_h2;
-  // dst = Line_h + hsvSplit[1] + hsvSplit[2];
-  if(m_visable)  //调试用
-  {
-    merge(hsvSplit, hsv);
-    imshow("getYellowRegion hsv", hsv);
-    waitKey(1);
-  }
-
-  vector<Mat> bgrSplit;
-  Mat large, abs, region1, region2,
-      region3,  //分别为G-B>...，R-B>...,|R-G|<...区域
-      bgrColorRegion;
-  split(src, bgrSplit);
-  compare(bgrSplit[1], bgrSplit[0], large, CMP_GT);
-  absdiff(bgrSplit[1], bgrSplit[0], abs);
-  threshold(abs, abs, 27, 255, THRESH_BINARY);
-  bitwise_and(abs, large, region1);
-  compare(bgrSplit[2], bgrSplit[0], large, CMP_GT);
-  absdiff(bgrSplit[2], bgrSplit[0], abs);
-  threshold(abs, abs, 27, 255, THRESH_BINARY);
-  bitwise_and(abs, large, region2);
-  absdiff(bgrSplit[2], bgrSplit[1], abs);
-  threshold(abs, region3, 35, 255, THRESH_BINARY_INV);
-
-  bitwise_and(region1, region2, bgrColorRegion);
-  bitwise_and(bgrColorRegion, region3, bgrColorRegion);
-  if(m_visable)
-  {
-    imshow("region3", region3);
-    waitKey(1);
-    imshow("region1 g-b", region1);
-    waitKey(1);
-    imshow("region2 r-b", region2);
-    waitKey(1);
-  }
-
-  bitwise_and(hsvColorRegion, bgrColorRegion, dst);
-  // dst = bgrColorRegion;
+  FrameContext frame(src);
+  getYellowRegion(frame, dst, LowH, HighH, sThreshold, vThreshold);
+}
+void RMChallengeVision::getYellowRegion(FrameContext& frame, Mat& dst,
+                                        int LowH, int HighH, int sThreshold,
+                                        int vThreshold)
+{
+  std::stringstream key;
+  key << "yellow " << LowH << " " << HighH << " " << sThreshold << " "
+      << vThreshold;
+  if(frame.findMask(key.str(), dst))
+    return;
+  dst.release();
+  /*all tests only depend on bgr, so the region is one table lookup per
+   * pixel, see yellowColorKernel*/
+  int params[LUT_PARAM_NUM]= { LowH, HighH, sThreshold, vThreshold };
+  int bit= findColorLut(params);
+  if(bit >= 0)
+    applyColorLut(frame.bgr(), bit, dst);
+  else
+    yellowColorKernel(frame.bgr(), params, dst);
+  frame.storeMask(key.str(), dst);
   if(m_visable)
   {
     imshow("Yellow Region", dst);
@@ -668,55 +1185,51 @@ void RMChallengeVision::detectLine(Mat& src, float& distance_x,
                                    float& distance_y, float& line_vector_x,
                                    float& line_vector_y)
 {
-  Mat img, copy;
+  FrameContext frame(src);
+  detectLine(frame, distance_x, distance_y, line_vector_x, line_vector_y);
+}
+void RMChallengeVision::detectLine(FrameContext& frame, float& distance_x,
+                                   float& distance_y, float& line_vector_x,
+                                   float& line_vector_y)
+{
+  const Mat& src= frame.bgr();
+  Mat yellow, img, copy;
   vector<Mat> bgrSplit;
-  vector<int> x, y;
   float picture_vector_x, picture_vector_y;  //图片参考系的距离向量
-  uchar* data;                               //获取图像数据所用数组
   if(m_visable)
     split(src, bgrSplit);  //分离出BGR通道，为最终显示结果做准备
 
-  getYellowRegion(src, img, 30, 47, 150, 90);  //获取黄色区域
+  getYellowRegion(frame, yellow, 30, 47, 150, 90);  //获取黄色区域
   Mat element1= getStructuringElement(
       MORPH_ELLIPSE, Size(3, 3));  //设置腐蚀的核大小,5x5的椭圆，即圆
   Mat element2=
       getStructuringElement(MORPH_ELLIPSE, Size(9, 9));  //设置膨胀的核大小
-  erode(img, img, element1);                             //腐蚀，去除噪点
+  erode(yellow, img, element1);  //腐蚀，去除噪点，不改动缓存的黄色区域
   dilate(img, img, element2);                            //膨胀，增加线粗
   //去除面积较小的连通域
-  vector<vector<Point> > contours;
-  Mat temp;
-  img.copyTo(temp);
-  cv::findContours(temp, contours, CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE);
-  for(int i= 0; i < (int)contours.size(); i++)
-  {
-    int area= contourArea(contours[i], false);
-    if(area < 1500)
-      drawContours(img, contours, i, Scalar(0), CV_FILLED);
-  }
+  vector<BLOB_STAT> blobs;
+  removeSmallBlobs(img, 1500, blobs);
   if(m_visable)
   {
     imshow("img pre process", img);
     waitKey(1);
   }
 
-  for(int i= 0; i < src.rows; ++i)  //遍历每一行
+  //所有黄色像素的矩，即保留下来的连通域的矩之和
+  long long n= 0, sx= 0, sy= 0, sxx= 0, sxy= 0, syy= 0;
+  for(int k= 0; k < (int)blobs.size(); k++)
   {
-    data= img.ptr<uchar>(i);          //获取此行开头指针
-    for(int j= 0; j < src.cols; ++j)  //遍历此行每个元素
-    {
-      if(*data == 255)  //如果刚好满足之前4个条件（255 =255&255&255&255）
-      {
-        x.push_back(j);  //添加 x 坐标
-        y.push_back(i);  //添加 y 坐标
-      }
-      ++data;  //指到下一个元素
-    }
+    n+= blobs[k].area;
+    sx+= blobs[k].m10;
+    sy+= blobs[k].m01;
+    sxx+= blobs[k].m20;
+    sxy+= blobs[k].m11;
+    syy+= blobs[k].m02;
   }
 
-  if(x.size() > 1500)  //如果有数据
+  if(n > 1500)  //如果有数据
   {
-    LeastSquare leastsq(x, y);  //拟合曲线
+    LeastSquare leastsq(n, sx, sy, sxx, sxy, syy);  //拟合直线
     leastsq.direction(src.cols / 2, src.rows / 2, picture_vector_x,
                       picture_vector_y);  //获取中心点到直线的向量,图像坐标
     distance_y= picture_vector_x;  //转换为无人机坐标
@@ -743,6 +1256,64 @@ void RMChallengeVision::detectLine(Mat& src, float& distance_x,
     line_vector_y= 0;
   }
 }
+/**********************************************************
+         函数名：rectSidePoints
+           功能：以点(x,y)为中心，2r为边长的矩形边缘点（顺时针方向）
+                超出边界时返回false
+*********************************************************/
+static bool rectSidePoints(int cols, int rows, int x, int y, int r,
+                           vector<Point>& points)
+{
+  points.clear();
+  if(!((x >= r) && ((x + r) < cols) && (y >= r) && ((y + r) < rows)))
+    return false;
+  for(int k= x - r; k < x + r; ++k)
+    points.push_back(Point(k, y - r));
+  for(int k= y - r + 1; k < y + r; ++k)
+    points.push_back(Point(x + r, k));
+  for(int k= x + r - 1; k >= x - r; --k)
+    points.push_back(Point(k, y + r));
+  for(int k= y + r - 1; k > y - r; --k)
+    points.push_back(Point(x - r, k));
+  return true;
+}
+
+/**********************************************************
+         函数名：boxDensity
+           功能：用积分图求以(x,y)为中心，边长2half+1的方框内的像素和
+*********************************************************/
+static int boxDensity(const Mat& sum, int x, int y, int half)
+{
+  int x0= std::max(x - half, 0), y0= std::max(y - half, 0);
+  int x1= std::min(x + half + 1, sum.cols - 1),
+      y1= std::min(y + half + 1, sum.rows - 1);
+  return sum.at<int>(y1, x1) - sum.at<int>(y0, x1) - sum.at<int>(y1, x0) +
+         sum.at<int>(y0, x0);
+}
+
+/**********************************************************
+         函数名：isTriSide
+           功能：边缘上0到255和255到0的跳变各有三次即为三条边
+*********************************************************/
+static bool isTriSide(const vector<uchar>& sides, bool visable)
+{
+  int plus_sum= 0, minus_sum= 0;
+  for(int k= 0; k < (int)sides.size() - 1; k++)
+    if((sides[k + 1] - sides[k]) == 255)
+    {
+      plus_sum++;
+      if(visable)
+        cout << "From:isTri side position:" << k << " +" << plus_sum << endl;
+    }
+    else if((sides[k + 1] - sides[k]) == -255)
+    {
+      minus_sum++;
+      if(visable)
+        cout << "From:isTri side position:" << k << " -" << minus_sum << endl;
+    }
+  return plus_sum == 3 && minus_sum == 3;
+}
+
 /**************************************************************
         函数名：detectLineWithT
         功能： 判断是否有T型，若有，返回true
@@ -758,53 +1329,51 @@ bool RMChallengeVision::detectLineWithT(Mat& src, float& distance_x,
                                         float& distance_y, float& line_vector_x,
                                         float& line_vector_y)
 {
-  Mat img, T_img, copy;  // img用于拟合，T_img用于判断
+  FrameContext frame(src);
+  return detectLineWithT(frame, distance_x, distance_y, line_vector_x,
+                         line_vector_y);
+}
+bool RMChallengeVision::detectLineWithT(FrameContext& frame, float& distance_x,
+                                        float& distance_y, float& line_vector_x,
+                                        float& line_vector_y)
+{
+  const Mat& src= frame.bgr();
+  Mat yellow, img, T_img, copy;  // img用于拟合，T_img用于判断
   vector<Mat> bgrSplit;
-  vector<int> x, y;                          // x，y坐标储存vector
   float picture_vector_x, picture_vector_y;  //图片参考系的距离向量
-  int side= 71;                              //判断T型的核边长大小
-  double val_max;                            //高斯滤波后的最大值
-  Point p_max;                               //高斯滤波后最大值的位置
-  uchar* data;                               //获取图像数据所用数组
+  int side= 71;                              //判断T型的边长大小
+  int half= T_BOX / 2;                       //密度方框的半边长
+  int val_max= 0;                            //方框密度的最大值
+  Point p_max;                               //方框密度最大值的位置
 
   if(m_visable)
     split(src, bgrSplit);  //分离出BGR通道，为最终显示结果做准备
-  getYellowRegion(src, img, 30, 53, 99, 140);  //获取黄色区域
+  getYellowRegion(frame, yellow, 30, 53, 99, 140);  //获取黄色区域
   Mat element1= getStructuringElement(
       MORPH_ELLIPSE, Size(3, 3));  //设置腐蚀的核大小,5x5的椭圆，即圆
   Mat element2=
       getStructuringElement(MORPH_ELLIPSE, Size(9, 9));  //设置膨胀的核大小
-  erode(img, img, element1);                             //腐蚀，去除噪点
+  erode(yellow, img, element1);  //腐蚀，去除噪点，不改动缓存的黄色区域
   dilate(img, img, element2);  //膨胀，增加T型交叉点密度
   //去除面积较小的连通域
-  vector<vector<Point> > contours;
-  Mat temp;
-  img.copyTo(temp);
-  cv::findContours(temp, contours, CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE);
-  for(int i= 0; i < (int)contours.size(); i++)
-  {
-    int area= contourArea(contours[i], false);
-    if(area < 1500)
-      drawContours(img, contours, i, Scalar(0), CV_FILLED);
-  }
+  vector<BLOB_STAT> blobs;
+  removeSmallBlobs(img, 1500, blobs);
   if(m_visable)
   {
     imshow("img pre process", img);
     waitKey(1);
   }
 
-  for(int i= 0; i < src.rows; ++i)  //遍历每一行
+  //所有黄色像素的矩，即保留下来的连通域的矩之和
+  long long n= 0, sx= 0, sy= 0, sxx= 0, sxy= 0, syy= 0;
+  for(int k= 0; k < (int)blobs.size(); k++)
   {
-    data= img.ptr<uchar>(i);          //获取此行开头指针
-    for(int j= 0; j < src.cols; ++j)  //遍历此行每个元素
-    {
-      if(*data == 255)  //如果刚好满足之前4个条件（255 =255&255&255&255）
-      {
-        x.push_back(j);  //添加 x 坐标
-        y.push_back(i);  //添加 y 坐标
-      }
-      ++data;  //指到下一个元素
-    }
+    n+= blobs[k].area;
+    sx+= blobs[k].m10;
+    sy+= blobs[k].m01;
+    sxx+= blobs[k].m20;
+    sxy+= blobs[k].m11;
+    syy+= blobs[k].m02;
   }
 
   // cout
@@ -815,18 +1384,35 @@ bool RMChallengeVision::detectLineWithT(Mat& src, float& distance_x,
 
   // if(if_Tri(T_img, p_max.x, p_max.y, side,
   // if_debug))//判断最大点周围是否有三条边，若有，肯定为T型
-  if(x.size() > 1500)  //如果有数据
+  if(n > 1500)  //如果有数据
   {
-    GaussianBlur(img, T_img, Size(side, side), 0);  //高斯滤波，计算各点黄色密度
-    minMaxLoc(T_img, NULL, &val_max, NULL, &p_max);  //得到密度最大点位置和值
-    threshold(T_img, T_img, val_max / 2, 255,
-              THRESH_BINARY);  //获取二值图，便于使用isTri函数
-    if(isTri(T_img, p_max.x, p_max.y, side / 2) &&
-       isTri(T_img, p_max.x, p_max.y,
-             side))  //当最大点周围两圈都有三条边
+    //积分图，任意位置的方框内黄色像素数都是O(1)
+    Mat sum;
+    integral(img, sum, CV_32S);
+    //密度最大的点一定在黄色区域的包围盒内
+    Rect box= blobs[0].bbox;
+    for(int k= 1; k < (int)blobs.size(); k++)
+      box|= blobs[k].bbox;
+    for(int i= box.y; i < box.y + box.height; ++i)
+      for(int j= box.x; j < box.x + box.width; ++j)
+      {
+        int density= boxDensity(sum, j, i, half);
+        if(density > val_max)
+        {
+          val_max= density;
+          p_max= Point(j, i);
+        }
+      }
+    if(isTri(sum, p_max.x, p_max.y, side / 2, half, val_max / 2) &&
+       isTri(sum, p_max.x, p_max.y, side, half,
+             val_max / 2))  //当最大点周围两圈都有三条边
     {
       if(m_visable)
       {
+        //只在调试时生成二值化的密度图
+        boxFilter(img, T_img, CV_32F, Size(T_BOX, T_BOX), Point(-1, -1),
+                  false);
+        threshold(T_img, T_img, val_max / 2, 255, THRESH_BINARY);
         imshow("T_img", T_img);
         waitKey(1);
       }
@@ -842,7 +1428,7 @@ bool RMChallengeVision::detectLineWithT(Mat& src, float& distance_x,
     }
     else  //不是T型，则计算距离向量
     {
-      LeastSquare leastsq(x, y);  //拟合曲线
+      LeastSquare leastsq(n, sx, sy, sxx, sxy, syy);  //拟合直线
       leastsq.direction(src.cols / 2, src.rows / 2, picture_vector_x,
                         picture_vector_y);  //获取中心点到直线的向量,图像坐标
       distance_y= picture_vector_x;  //转换为无人机坐标
@@ -880,52 +1466,18 @@ bool RMChallengeVision::detectLineWithT(Mat& src, float& distance_x,
            功能：获取以点(x,y)为中心，2r为边长的矩形边缘点（顺时针方向）
                 结果储存在引用参数 side中
                 获取成功时返回true，超出边界时返回false
-                if_debug设为true时，会在原图上绘制值为120点，注意：会改变原图
+                不改变原图
 *********************************************************/
 /**********************************************************/
 bool RMChallengeVision::getRectSide(Mat& src, vector<uchar>& side, int x, int y,
                                     int r)
 {
-  if((x >= r) && ((x + r) < src.cols) && (y >= r) &&
-     ((y + r) < src.rows))  //是否超边界
-  {
-    uchar* data= src.ptr<uchar>(y - r);  //获取边缘点值
-    for(int k= x - r; k < x + r; ++k)
-    {
-      side.push_back(*(data + k));
-      if(m_visable)
-        if(*(data + k) != 255)
-          *(data + k)= 120;
-    }
-    for(int k= y - r + 1; k < y + r; ++k)
-    {
-      data= src.ptr<uchar>(k);
-      side.push_back(*(data + x + r));
-      if(m_visable)
-        if(*(data + x + r) != 255)
-          *(data + x + r)= 120;
-    }
-    data= src.ptr<uchar>(y + r);
-    for(int k= x + r - 1; k >= x - r; --k)
-    {
-      side.push_back(*(data + k));
-      if(m_visable)
-        if(*(data + k) != 255)
-          *(data + k)= 120;
-    }
-    for(int k= y + r - 1; k > y - r; --k)
-    {
-      data= src.ptr<uchar>(k);
-      side.push_back(*(data + x - r));
-      if(m_visable)
-        if(*(data + x - r) != 255)
-          *(data + x - r)= 120;
-    }
-
-    return true;
-  }
-  else
+  vector<Point> points;
+  if(!rectSidePoints(src.cols, src.rows, x, y, r, points))
     return false;
+  for(int k= 0; k < (int)points.size(); ++k)
+    side.push_back(src.at<uchar>(points[k]));
+  return true;
 }
 /**************************************************************
         函数名：isTri
@@ -936,79 +1488,71 @@ bool RMChallengeVision::getRectSide(Mat& src, vector<uchar>& side, int x, int y,
 **********************************************************/
 bool RMChallengeVision::isTri(Mat& src, int x, int y, int r)
 {
-  Mat copy= src.clone();
-  int plus_sum= 0, minus_sum= 0;
   vector<uchar> sides;
-  if(getRectSide(copy, sides, x, y, r))
+  if(!getRectSide(src, sides, x, y, r) || !isTriSide(sides, m_visable))
+    return false;
+  if(m_visable)
   {
-    for(int k= 0; k < (int)sides.size() - 1; k++)
-      if((sides[k + 1] - sides[k]) == 255)
-      {
-        plus_sum++;
-        if(m_visable)
-          cout << "From:isTri side position:" << k << " +" << plus_sum << endl;
-      }
-      else if((sides[k + 1] - sides[k]) == -255)
-      {
-        minus_sum++;
-        if(m_visable)
-          cout << "From:isTri side position:" << k << " -" << minus_sum << endl;
-      }
-
-    if(plus_sum == 3 && minus_sum == 3)
-    {
-      if(m_visable)
-      {
-        cout << "LineWithT position:" << x << " " << y << endl;
-        imshow("isTri point", copy);
-        waitKey(1);
-      }
-      return true;
-    }
+    //只在调试时复制原图并画出边缘，值为120
+    Mat copy= src.clone();
+    vector<Point> points;
+    rectSidePoints(src.cols, src.rows, x, y, r, points);
+    for(int k= 0; k < (int)points.size(); ++k)
+      if(copy.at<uchar>(points[k]) != 255)
+        copy.at<uchar>(points[k])= 120;
+    cout << "LineWithT position:" << x << " " << y << endl;
+    imshow("isTri point", copy);
+    waitKey(1);
+  }
+  return true;
+}
+/**************************************************************
+        函数名：isTri
+        功能：同上，边缘点的值由积分图上方框密度是否大于thresh得到，
+            不需要生成滤波和二值化后的图
+        输入：sum: 黄色区域的积分图，half: 方框半边长
+**********************************************************/
+bool RMChallengeVision::isTri(const Mat& sum, int x, int y, int r, int half,
+                              int thresh)
+{
+  vector<Point> points;
+  if(!rectSidePoints(sum.cols - 1, sum.rows - 1, x, y, r, points))
     return false;
+  vector<uchar> sides(points.size());
+  for(int k= 0; k < (int)points.size(); ++k)
+  {
+    int density= boxDensity(sum, points[k].x, points[k].y, half);
+    sides[k]= density > thresh ? 255 : 0;
   }
-  else
+  if(!isTriSide(sides, m_visable))
     return false;
+  if(m_visable)
+    cout << "LineWithT position:" << x << " " << y << endl;
+  return true;
 }
 /*******************************************************
         函数名：hasTri
         功能：判断图片中是否有点周围r距离有三条边
-        要求：输入高斯滤波后的图和图中最大值
-        原理：选取所有处于(0.968al_max,val_max]的点
+        要求：输入黄色区域的积分图和方框密度的最大值
+        原理：选取所有处于(0.98val_max,val_max]的点
             若其中有点周围有三条边，就判断有T型
+            每个点只需在积分图上取边缘点的方框密度，点数多时也很快
 *******************************************************/
-bool RMChallengeVision::hasTri(Mat& src, int r, int val_max)
-{
-  vector<int> x, y;
-  // int rand_index;
-  Mat img_1, img_2;
-  uchar* data;
-  static int T_cnt= 0;
-  // srand( val_max );
-  threshold(src, img_2, val_max / 2, 255,
-            THRESH_BINARY);  //获取二值图，便于使用if_Tri函数
-  threshold(src, img_1, val_max * 0.98, 255, THRESH_BINARY);
-  for(int i= 0; i < src.rows; ++i)  //遍历每一行
-  {
-    data= img_1.ptr<uchar>(i);        //获取此行开头指针
-    for(int j= 0; j < src.cols; ++j)  //遍历此行每个元素
-    {
-      if(*data == 255)  //如果刚好满足之前4个条件（255 =255&255&255&255）
-      {
-        x.push_back(j);  //添加 x 坐标
-        y.push_back(i);  //添加 y 坐标
-      }
-      ++data;  //指到下一个元素
-    }
-  }
-  for(int i= 0; i < (int)x.size(); i+= 2)
+bool RMChallengeVision::hasTri(const Mat& sum, int half, int r, int val_max)
+{
+  int& T_cnt= m_T_cnt;
+  for(int i= 0; i < sum.rows - 1; ++i)  //遍历每一行
   {
-    // rand_index = rand() % x.size();
-    if(isTri(img_2, x[i], y[i], r))
+    for(int j= 0; j < sum.cols - 1; j+= 2)
     {
-      ++T_cnt;
-      if(T_cnt >= 3)
-        return true;
+      if(boxDensity(sum, j, i, half) <= val_max * 0.98)
+        continue;
+      if(isTri(sum, j, i, r, half, val_max / 2))
+      {
+        ++T_cnt;
+        if(T_cnt >= 3)
+          return true;
+      }
     }
   }
   {
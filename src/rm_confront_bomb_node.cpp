@@ -48,6 +48,7 @@
 #include <geometry_msgs/Vector3Stamped.h>
 #include <image_transport/image_transport.h>
 #include <ros/assert.h>
+#include <ros/callback_queue.h>
 #include <ros/ros.h>
 #include <sensor_msgs/LaserScan.h>
 #include <sensor_msgs/image_encodings.h>
@@ -55,6 +56,10 @@
 #include <sstream>
 #include "std_msgs/String.h"
 #include "std_msgs/UInt8.h"
+#include "test2/BomberResult.h"
+#include "test2/PillarResult.h"
+#include "rm_challenge_seqlock.h"
+#include "rm_challenge_serial_commander.h"
 // C++标准库
 #include <math.h>
 #include <fstream>
@@ -79,8 +84,8 @@ void rc_channels_callback(const dji_sdk::RCChannels rc_channels);
 #endif
 void uav_state_callback(const std_msgs::UInt8::ConstPtr &msg);
 void guidance_distance_callback(const sensor_msgs::LaserScan &g_oa);
-void vision_base_callback(const std_msgs::String::ConstPtr &msg);
-void vision_pillar_callback(const std_msgs::String::ConstPtr &msg);
+void vision_base_callback(const test2::BomberResult::ConstPtr &msg);
+void vision_pillar_callback(const test2::PillarResult::ConstPtr &msg);
 /**timer callback, control uav in a finite state machine*/
 void taskTimerCallback(const ros::TimerEvent &evt);
 void ledTimerCallback(const ros::TimerEvent &evt);
@@ -109,10 +114,8 @@ enum PREPARE_TO_LAND_TYPE
   PREPARE_AT_SUPER_LOW,
 };
 PREPARE_TO_LAND_TYPE g_prepare_to_land_type;
-/**serial port*/
-boost::asio::serial_port *g_serial_port;
-boost::system::error_code g_err_code;
-boost::asio::io_service g_io_service;
+/**serial port, written on its own thread*/
+SerialCommander g_serial;
 /**dji sdk*/
 #if CURRENT_COMPUTER == MANIFOLD
 DJIDrone *g_drone;
@@ -132,9 +135,38 @@ VISION_STATE g_vision_state= VISION_ALL;
 ros::Publisher g_pillar_task_pub;
 ros::Publisher g_base_task_pub;
 ros::Publisher g_velocity_pub;
+/**inputs of the callbacks. The variables above belong to the control
+ * thread, each callback only writes its input here and updateInputs()
+ * copies them at the start of every control tick*/
+struct RC_INPUT
+{
+  int channel;
+  bool is_F_mode;
+};
+struct BASE_INPUT
+{
+  float vx;
+  float vy;
+  bool can_bomb;
+  bool found;
+};
+struct PILLAR_INPUT
+{
+  bool circle_found;
+  float circle_position[2];
+  float height;
+  int triangle[4];
+  bool arc_found;
+  float arc_position[2];
+};
+SeqLock<RC_INPUT> g_rc_input;
+SeqLock<BASE_INPUT> g_base_input;
+SeqLock<PILLAR_INPUT> g_pillar_input;
+SeqLock<float> g_height_input;
 /**
 *global functions
 */
+void updateInputs();
 void informGraspperChange(std::string state);
 void controlGraspper(std::string state);
 void controlDroneVelocity(float x, float y, float z, float yaw);
@@ -197,12 +229,14 @@ int main(int argc, char **argv)
   /*initialize vision task control publisher*/
   g_pillar_task_pub= node.advertise<std_msgs::String>("/tpp/pillar_task", 1);
   g_base_task_pub= node.advertise<std_msgs::String>("/tpp/base_task", 1);
-  /*initialize timers*/
-  ros::Timer task_timer=
-      node.createTimer(ros::Duration(1.0 / 50.0), taskTimerCallback);
+  /*initialize timers, on a queue and a thread of their own so they run
+   * on time behind bursts of sensor messages*/
+  ros::CallbackQueue control_queue;
+  ros::Timer task_timer= node.createTimer(ros::TimerOptions(
+      ros::Duration(1.0 / 50.0), taskTimerCallback, &control_queue));
 
-  ros::Timer led_timer=
-      node.createTimer(ros::Duration(1.0 / 5.0), ledTimerCallback);
+  ros::Timer led_timer= node.createTimer(ros::TimerOptions(
+      ros::Duration(1.0 / 5.0), ledTimerCallback, &control_queue));
 
   initilizeSerialPort();
 
@@ -210,12 +244,15 @@ int main(int argc, char **argv)
   g_drone= new DJIDrone(node);
 #endif
 
-  /*main loop begin */
+  /*main loop begin, sensors on this thread, control on the other*/
+  ros::AsyncSpinner control_spinner(1, &control_queue);
+  control_spinner.start();
   ros::spin();
+  control_spinner.stop();
 
   /*release resource*/
   g_cap.release();
-  delete g_serial_port;
+  g_serial.close();
 #if CURRENT_COMPUTER == MANIFOLD
   g_drone->release_sdk_permission_control();
   delete g_drone;
@@ -225,6 +262,7 @@ int main(int argc, char **argv)
 
 void ledTimerCallback(const ros::TimerEvent &evt)
 {
+  updateInputs();
   updateLEDColor();
   ROS_INFO_STREAM("update color");
 }
@@ -232,6 +270,7 @@ void ledTimerCallback(const ros::TimerEvent &evt)
 void taskTimerCallback(const ros::TimerEvent &evt)
 {
   ROS_INFO_STREAM("loop:");
+  updateInputs();
 
   /*do different task according to mode*/
   switch(g_RC_channel)
@@ -283,8 +322,11 @@ void rc_channels_callback(const dji_sdk::RCChannels rc_channels)
 {
   /*receive rc channel here and set flags*/
   g_rc_channels= rc_channels;
+  /*the channel stays when the gear is in between*/
+  static RC_INPUT input= { RC_P_UP, false };
   if(fabs(rc_channels.mode - 8000) < 0.000001)
   {
+    input.is_F_mode= true;
     /*get sdk control*/
     if(!g_is_sdk_control)
     {
@@ -296,14 +338,14 @@ void rc_channels_callback(const dji_sdk::RCChannels rc_channels)
 
     if(fabs(rc_channels.gear + 10000) < 0.000001)
     {
-      g_RC_channel= RC_F_UP;
+      input.channel= RC_F_UP;
       ROS_INFO_STREAM("RC channel is: F up");
       if(g_vision_state != VISION_PILLAR)
         changeVisionTask(VISION_PILLAR);
     }
     else if(fabs(rc_channels.gear + 4545) < 0.000001)
     {
-      g_RC_channel= RC_F_DOWN;
+      input.channel= RC_F_DOWN;
       ROS_INFO_STREAM("RC channel is: F down");
       if(g_vision_state != VISION_BASE)
         changeVisionTask(VISION_BASE);
@@ -311,20 +353,20 @@ void rc_channels_callback(const dji_sdk::RCChannels rc_channels)
   }
   else
   {
+    input.is_F_mode= false;
     g_is_sdk_control= false;
     changeVisionTask(VISION_ALL);
-    g_prepare_to_land_type=PREPARE_AT_HIGH;
 
     if(fabs(rc_channels.mode + 8000) < 0.000001)
     {
       if(fabs(rc_channels.gear + 10000) < 0.000001)
       {
-        g_RC_channel= RC_P_UP;
+        input.channel= RC_P_UP;
         ROS_INFO_STREAM("RC channel is: P up");
       }
       else if(fabs(rc_channels.gear + 4545) < 0.000001)
       {
-        g_RC_channel= RC_P_DOWN;
+        input.channel= RC_P_DOWN;
         ROS_INFO_STREAM("RC channel is: P down");
       }
     }
@@ -332,19 +374,54 @@ void rc_channels_callback(const dji_sdk::RCChannels rc_channels)
     {
       if(fabs(rc_channels.gear + 10000) < 0.000001)
       {
-        g_RC_channel= RC_A_UP;
+        input.channel= RC_A_UP;
         ROS_INFO_STREAM("RC channel is: A up");
       }
       else if(fabs(rc_channels.gear + 4545) < 0.000001)
       {
-        g_RC_channel= RC_A_DOWN;
+        input.channel= RC_A_DOWN;
         ROS_INFO_STREAM("RC channel is: A down");
       }
     }
   }
+  g_rc_input.write(input);
 }
 #endif
 
+void updateInputs()
+{
+  RC_INPUT rc;
+  if(g_rc_input.read(rc) > 0)
+  {
+    g_RC_channel= rc.channel;
+    if(!rc.is_F_mode)
+      g_prepare_to_land_type= PREPARE_AT_HIGH;
+  }
+
+  BASE_INPUT base;
+  if(g_base_input.read(base) > 0)
+  {
+    g_base_vx= base.vx;
+    g_base_vy= base.vy;
+    g_can_bomb= base.can_bomb;
+    g_discover_base= base.found;
+  }
+
+  float height;
+  if(g_height_input.read(height) > 0)
+    g_height_from_guidance= height;
+
+  /*after the height, the arc error is scaled by it*/
+  PILLAR_INPUT pillar;
+  if(g_pillar_input.read(pillar) > 0)
+  {
+    setCircleVariables(pillar.circle_found, pillar.circle_position,
+                       pillar.height);
+    setTriangleVariables(pillar.triangle);
+    setArcVariables(pillar.arc_found, pillar.arc_position);
+  }
+}
+
 void uav_state_callback(const std_msgs::UInt8::ConstPtr &msg)
 {
   int flight_status= msg->data;
@@ -357,15 +434,13 @@ void informGraspperChange(std::string state)
     return;
   else if(state == "open")
   {
-    for(int i= 0; i < 10; i++)
-      boost::asio::write(*g_serial_port, boost::asio::buffer("b"), g_err_code);
+    g_serial.send(SERIAL_GRASPPER, 'b');
     g_current_channel= g_RC_channel;
     ROS_INFO_STREAM("open");
   }
   else if(state == "close")
   {
-    for(int i= 0; i < 10; i++)
-      boost::asio::write(*g_serial_port, boost::asio::buffer("a"), g_err_code);
+    g_serial.send(SERIAL_GRASPPER, 'a');
     g_current_channel= g_RC_channel;
     ROS_INFO_STREAM("close");
   }
@@ -375,15 +450,13 @@ void controlGraspper(std::string state)
 {
   if(state == "open")
   {
-    for(int i= 0; i < 10; i++)
-      boost::asio::write(*g_serial_port, boost::asio::buffer("b"), g_err_code);
+    g_serial.send(SERIAL_GRASPPER, 'b');
     g_current_channel= g_RC_channel;
     ROS_INFO_STREAM("open graspper");
   }
   else if(state == "close")
   {
-    for(int i= 0; i < 10; i++)
-      boost::asio::write(*g_serial_port, boost::asio::buffer("a"), g_err_code);
+    g_serial.send(SERIAL_GRASPPER, 'a');
     g_current_channel= g_RC_channel;
     ROS_INFO_STREAM("close graspper");
   }
@@ -391,34 +464,24 @@ void controlGraspper(std::string state)
 
 void initilizeSerialPort()
 {
-  g_serial_port= new boost::asio::serial_port(g_io_service);
-  g_serial_port->open("/dev/ttyTHS0", g_err_code);
-  g_serial_port->set_option(serial_port::baud_rate(9600), g_err_code);
-  g_serial_port->set_option(
-      serial_port::flow_control(serial_port::flow_control::none), g_err_code);
-  g_serial_port->set_option(serial_port::parity(serial_port::parity::none),
-                            g_err_code);
-  g_serial_port->set_option(serial_port::stop_bits(serial_port::stop_bits::one),
-                            g_err_code);
-  g_serial_port->set_option(serial_port::character_size(8), g_err_code);
-}
-
-void vision_base_callback(const std_msgs::String::ConstPtr &msg)
-{
-  float vx, vy;
-  bool can_bomb, discover_base;
-  g_base_vx= 0;
-  g_base_vy= 0;
-  g_can_bomb= false;
-  std::stringstream ss(msg->data.c_str());
-  ss >> g_base_vx >> g_base_vy >> g_can_bomb >> g_discover_base;
+  g_serial.open("/dev/ttyTHS0", 9600);
+}
+
+void vision_base_callback(const test2::BomberResult::ConstPtr &msg)
+{
+  BASE_INPUT input;
+  input.vx= msg->vx;
+  input.vy= msg->vy;
+  input.can_bomb= msg->can_bomb;
+  input.found= msg->base_found;
   /*limit the maximum of velocity*/
-  g_base_vx= fabs(g_base_vx) > MAX_VELOCITY ?
-                 MAX_VELOCITY * (fabs(g_base_vx) / (g_base_vx + 0.000001)) :
-                 g_base_vx;
-  g_base_vy= fabs(g_base_vy) > MAX_VELOCITY ?
-                 MAX_VELOCITY * (fabs(g_base_vy) / (g_base_vy + 0.000001)) :
-                 g_base_vy;
+  input.vx= fabs(input.vx) > MAX_VELOCITY ?
+                MAX_VELOCITY * (fabs(input.vx) / (input.vx + 0.000001)) :
+                input.vx;
+  input.vy= fabs(input.vy) > MAX_VELOCITY ?
+                MAX_VELOCITY * (fabs(input.vy) / (input.vy + 0.000001)) :
+                input.vy;
+  g_base_input.write(input);
 }
 
 void controlDroneVelocity(float x, float y, float z, float yaw)
@@ -454,50 +517,41 @@ void changeLEDColor(LED_COLOR color)
   {
     case LED_RED:
     {
-      for(int i= 0; i < 10; i++)
-        boost::asio::write(*g_serial_port, boost::asio::buffer("c"),
-                           g_err_code);
+      g_serial.send(SERIAL_LED, 'c');
       break;
     }
     case LED_BLUE:
     {
-      for(int i= 0; i < 10; i++)
-        boost::asio::write(*g_serial_port, boost::asio::buffer("d"),
-                           g_err_code);
+      g_serial.send(SERIAL_LED, 'd');
       break;
     }
     case LED_GREEN:
     {
-      for(int i= 0; i < 10; i++)
-        boost::asio::write(*g_serial_port, boost::asio::buffer("e"),
-                           g_err_code);
+      g_serial.send(SERIAL_LED, 'e');
       break;
     }
     case LED_WHITE:
     {
-      for(int i= 0; i < 10; i++)
-        boost::asio::write(*g_serial_port, boost::asio::buffer("h"),
-                           g_err_code);
+      g_serial.send(SERIAL_LED, 'h');
       break;
     }
   }
 }
 
-void vision_pillar_callback(const std_msgs::String::ConstPtr &msg)
+void vision_pillar_callback(const test2::PillarResult::ConstPtr &msg)
 {
-  float h;
-  float circle_pos[2];
-  float arc_pos[2];
-  int tri[4];
-  bool circle_found, arc_found;
-  ROS_INFO_STREAM(msg->data);
-  std::stringstream ss(msg->data.c_str());
-  ss >> tri[0] >> tri[1] >> tri[2] >> tri[3] >> circle_found >> circle_pos[1] >>
-      circle_pos[0] >> h >> arc_pos[1] >> arc_pos[0] >> arc_found;
-  setCircleVariables(circle_found, circle_pos, h);
-  setTriangleVariables(tri);
-  // height not used,set to 0
-  setArcVariables(arc_found, arc_pos);
+  PILLAR_INPUT input;
+  /*image x is the second axis of the uav*/
+  input.circle_found= msg->circle_found;
+  input.circle_position[0]= msg->circle_y;
+  input.circle_position[1]= msg->circle_x;
+  input.height= msg->height;
+  for(int i= 0; i < 4; i++)
+    input.triangle[i]= msg->triangle[i];
+  input.arc_found= msg->arc_found;
+  input.arc_position[0]= msg->arc_y;
+  input.arc_position[1]= msg->arc_x;
+  g_pillar_input.write(input);
 }
 
 void setCircleVariables(bool is_circle_found, float position_error[2],
@@ -555,7 +609,7 @@ void guidance_distance_callback(const sensor_msgs::LaserScan &g_oa)
            g_oa.header.stamp.sec);
   ROS_INFO("obstacle distance: [%f %f %f %f %f]\n", g_oa.ranges[0],
            g_oa.ranges[1], g_oa.ranges[2], g_oa.ranges[3], g_oa.ranges[4]);
-  g_height_from_guidance= g_oa.ranges[0];
+  g_height_input.write(g_oa.ranges[0]);
 }
 
 void droneGoToPillar()
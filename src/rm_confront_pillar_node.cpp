@@ -1,4 +1,6 @@
+#include "rm_challenge_image_publisher.h"
 #include "rm_challenge_vision.h"
+#include "test2/PillarResult.h"
 #define M100_CAMERA 1
 #define VIDEO_STREAM 2
 //#define CURRENT_IMAGE_SOURCE VIDEO_STREAM
@@ -7,7 +9,7 @@
 
 /**global publisher*/
 ros::Publisher vision_pillar_pub;
-image_transport::Publisher g_image_pub;
+ImagePublisher g_image_pub;
 ros::Subscriber pillar_change_sub;
 /**color and task flag*/
 RMChallengeVision::COLOR_TYPE g_color= RMChallengeVision::RED;
@@ -19,15 +21,14 @@ int main(int argc, char **argv)
   ros::init(argc, argv, "rm_challenge_camera_node");
   ros::NodeHandle node;
 
-  vision_pillar_pub= node.advertise<std_msgs::String>("tpp/pillar", 1);
+  vision_pillar_pub= node.advertise<test2::PillarResult>("tpp/pillar", 1);
   pillar_change_sub=
       node.subscribe("/tpp/pillar_task", 1, pillarChangeCallback);
 
   /*initialize camera and publish to pillar and base*/
-  image_transport::ImageTransport image_transport(node);
-  g_image_pub= image_transport.advertise("m100/image", 1);
+  ros::NodeHandle private_node("~");
+  g_image_pub.advertise(node, private_node, "m100/image");
   Mat frame, image_gray;
-  sensor_msgs::ImagePtr image_ptr;
 
   cv::VideoCapture g_cap;
 #if CURRENT_IMAGE_SOURCE == VIDEO_STREAM
@@ -46,8 +47,6 @@ int main(int argc, char **argv)
   RMChallengeVision vision;
   vision.setVisability(VISABILITY);
 
-  std::stringstream ss;
-
   //string str_get_we_color;
   //node.getParam("/rm_confront_pillar_node/rb_param",str_get_we_color);
   //char get_we_color=*str_get_we_color.c_str();
@@ -105,12 +104,10 @@ int main(int argc, char **argv)
     if(frame.empty())
       continue;
 
-    ss.str("");
-    /* publish this frame to ROS topic*/
-    image_ptr=
-        cv_bridge::CvImage(std_msgs::Header(), "bgr8", frame).toImageMsg();
-    g_image_pub.publish(image_ptr);
-    /*std_msg of string published to uav*/
+    /* publish this frame to ROS topic if anyone listens*/
+    std_msgs::Header header;
+    header.stamp= ros::Time::now();
+    g_image_pub.publish(frame, header.stamp);
 
     /*test detect pillar circle and triangles*/
     if(g_is_pillar_running)
@@ -128,33 +125,32 @@ int main(int argc, char **argv)
       ROS_INFO_STREAM("pillar color is: " << color);
       //    ROS_INFO_STREAM("detect pillar");
       RMChallengeVision::PILLAR_RESULT pillar_result;
-      float pos_err_x= 0, pos_err_y= 0, height= 0;
-      float arc_err_x= 1, arc_err_y= 1, arc_height= 2;
       vision.detectPillar(frame, g_color, pillar_result);
       ROS_INFO_STREAM("after detect pillar");
+      test2::PillarResultPtr pillar_msg(new test2::PillarResult);
+      pillar_msg->header= header;
+      for(int i= 0; i < 4; i++)
+        pillar_msg->triangle[i]= pillar_result.triangle[i];
+      pillar_msg->circle_found= pillar_result.circle_found;
+      pillar_msg->circle_x= pillar_msg->circle_y= pillar_msg->height= 0;
+      pillar_msg->arc_found= pillar_result.arc_found;
+      pillar_msg->arc_x= pillar_msg->arc_y= 1;
       if(pillar_result.circle_found)
       {
         // calculate height and pos_error
-        height= vision.imageToHeight(pillar_result.radius, 250.0);
-        pos_err_x= vision.imageToRealDistance(
+        pillar_msg->height= vision.imageToHeight(pillar_result.radius, 250.0);
+        pillar_msg->circle_x= vision.imageToRealDistance(
             pillar_result.radius, pillar_result.circle_center.x, 250.0);
-        pos_err_y= vision.imageToRealDistance(
+        pillar_msg->circle_y= vision.imageToRealDistance(
             pillar_result.radius, pillar_result.circle_center.y, 250.0);
       }
       if(pillar_result.arc_found)
       {
         /*send image pixel error to uav*/
-        arc_err_x= pillar_result.arc_center.x;
-        arc_err_y= pillar_result.arc_center.y;
+        pillar_msg->arc_x= pillar_result.arc_center.x;
+        pillar_msg->arc_y= pillar_result.arc_center.y;
       }
       // publish result to uav
-      std_msgs::String pillar_msg;
-      ss << pillar_result.triangle[0] << " " << pillar_result.triangle[1] << " "
-         << pillar_result.triangle[2] << " " << pillar_result.triangle[3] << " "
-         << pillar_result.circle_found << " " << pos_err_x << " " << pos_err_y
-         << " " << height << " " << arc_err_x << " " << arc_err_y << " "
-         << pillar_result.arc_found;
-      pillar_msg.data= ss.str();
       vision_pillar_pub.publish(pillar_msg);
 
 	  /*if(want_record_video=='y')
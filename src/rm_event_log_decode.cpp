@@ -0,0 +1,78 @@
+#include "rm_challenge_event_log.h"
+
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+
+/**
+ * Prints an event log written by EventLog as text, one event per line in
+ * time order:
+ *   <stamp> t<thread> <event> <field>=<value> ...
+ *
+ * usage: rm_event_log_decode <log file> [event name ...]
+ * when event names are given only those events are printed.
+ */
+
+static bool earlier(const EVENT_RECORD& a, const EVENT_RECORD& b)
+{
+  return a.stamp_ns < b.stamp_ns;
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 2)
+  {
+    std::cout << "usage: rm_event_log_decode <log file> [event name ...]"
+              << std::endl;
+    return -1;
+  }
+  FILE* file= fopen(argv[1], "rb");
+  if(file == NULL)
+  {
+    std::cout << "can't open " << argv[1] << std::endl;
+    return -2;
+  }
+  EVENT_FILE_HEADER header;
+  if(fread(&header, sizeof(header), 1, file) != 1 ||
+     memcmp(header.magic, "RMEV", 4) != 0 ||
+     header.record_size != sizeof(EVENT_RECORD))
+  {
+    std::cout << argv[1] << " is not an event log of this version"
+              << std::endl;
+    fclose(file);
+    return -3;
+  }
+
+  /*each thread's events are in order, the flushes interleave them*/
+  std::vector<EVENT_RECORD> records;
+  EVENT_RECORD record;
+  while(fread(&record, sizeof(record), 1, file) == 1)
+    records.push_back(record);
+  fclose(file);
+  std::stable_sort(records.begin(), records.end(), earlier);
+
+  char line[256];
+  for(int i= 0; i < (int)records.size(); i++)
+  {
+    const EVENT_RECORD& r= records[i];
+    const EVENT_INFO& info= EventLog::info(r.id);
+    bool selected= argc == 2;
+    for(int k= 2; k < argc && !selected; k++)
+      selected= strcmp(argv[k], info.name) == 0;
+    if(!selected)
+      continue;
+    int n= snprintf(line, sizeof(line), "%llu.%06llu t%d %s",
+                    (unsigned long long)(r.stamp_ns / 1000000000ULL),
+                    (unsigned long long)(r.stamp_ns % 1000000000ULL / 1000),
+                    r.thread, info.name);
+    if(info.value_name != NULL)
+      n+= snprintf(line + n, sizeof(line) - n, " %s=%d", info.value_name,
+                   r.value);
+    for(int k= 0; k < 4; k++)
+      if(info.data_name[k] != NULL)
+        n+= snprintf(line + n, sizeof(line) - n, " %s=%g", info.data_name[k],
+                     r.data[k]);
+    std::cout << line << "\n";
+  }
+  return 0;
+}
@@ -3,14 +3,15 @@
 #include <iostream>
 #include <string>
 #include <ros/ros.h>
+#include "rm_challenge_video_recorder.h"
 
 int main(int argc, char **argv)
 {
   ros::init(argc, argv, "rm_record_video");
   ros::NodeHandle node;
 
-  /*initialize video wrtier*/
-  cv::VideoWriter writer;
+  /*initialize video wrtier, it encodes on its own thread*/
+  VideoRecorder writer;
   std::string file_name;
   std::cout<<"please give a file name"<<std::endl;
   std::cin>>file_name;
@@ -32,11 +33,15 @@ int main(int argc, char **argv)
     cap>>frame;
     cv::imshow("frame",frame);
     writer.write(frame);
+    ROS_INFO_STREAM_THROTTLE(1.0, "frames recorded: "
+                                      << writer.getWrittenCount()
+                                      << " dropped: "
+                                      << writer.getDroppedCount());
     cv::waitKey(1);
   }
 
   cap.release();
-  writer.release();
+  writer.close();
 
   return 1;
 }
@@ -2,6 +2,7 @@
 
 /**subscribe image from m100*/
 image_transport::Subscriber m100_image_sub;
+cv_bridge::CvImageConstPtr g_m100_image_ptr;
 cv::Mat g_m100_image;
 RMChallengeVision vision;
 void m100ImageCallback(const sensor_msgs::Image::ConstPtr msg);
@@ -50,16 +51,17 @@ int main(int argc, char **argv)
 
 void m100ImageCallback(const sensor_msgs::Image::ConstPtr msg)
 {
-  cv_bridge::CvImagePtr cv_ptr;
+  /*share the message data instead of copying it*/
   try
   {
-    cv_ptr= cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::BGR8);
+    g_m100_image_ptr=
+        cv_bridge::toCvShare(msg, sensor_msgs::image_encodings::BGR8);
   }
   catch(cv_bridge::Exception &e)
   {
     ROS_ERROR("cv_bridge exception: %s", e.what());
     return;
   }
-  g_m100_image= cv_ptr->image;
+  g_m100_image= g_m100_image_ptr->image;
   ROS_INFO_STREAM("image arrive");
 }
@@ -0,0 +1,106 @@
+#include "rm_challenge_frame_context.h"
+#include "rm_challenge_image_mailbox.h"
+#include "rm_challenge_vision.h"
+
+#include <image_transport/image_transport.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace rm_challenge
+{
+/**
+ * rm_test_vision as a nodelet. Loaded into the camera's manager, it gets
+ * the frames of m100/image by pointer and runs the pillar and line
+ * detectors on them, without windows or recording.
+ * Parameters (private):
+ *   color: pillar color to look for, "r" or "b"
+ */
+class TestVisionNodelet : public nodelet::Nodelet
+{
+public:
+  TestVisionNodelet() : m_running(false)
+  {
+  }
+
+  ~TestVisionNodelet()
+  {
+    m_running= false;
+    if(m_thread.joinable())
+      m_thread.join();
+  }
+
+private:
+  virtual void onInit()
+  {
+    ros::NodeHandle& node= getNodeHandle();
+    ros::NodeHandle& private_node= getPrivateNodeHandle();
+
+    std::string color;
+    private_node.param<std::string>("color", color, "b");
+    if(color != "r" && color != "b")
+    {
+      NODELET_ERROR_STREAM("not a available color!");
+      return;
+    }
+    m_color= color == "r" ? RMChallengeVision::RED : RMChallengeVision::BLUE;
+
+    m_image_transport.reset(new image_transport::ImageTransport(node));
+    m_image_sub= m_image_transport->subscribe(
+        "m100/image", 1, &TestVisionNodelet::imageCallback, this);
+
+    /*the detectors run on our own thread, the callback only posts*/
+    m_running= true;
+    m_thread= std::thread(&TestVisionNodelet::processLoop, this);
+  }
+
+  void imageCallback(const sensor_msgs::ImageConstPtr& msg)
+  {
+    /*share the message data instead of copying it*/
+    try
+    {
+      m_mailbox.post(
+          cv_bridge::toCvShare(msg, sensor_msgs::image_encodings::BGR8));
+    }
+    catch(cv_bridge::Exception& e)
+    {
+      NODELET_ERROR("cv_bridge exception: %s", e.what());
+    }
+  }
+
+  void processLoop()
+  {
+    cv_bridge::CvImageConstPtr image_ptr;
+    while(m_running && ros::ok())
+    {
+      if(!m_mailbox.take(image_ptr, 1.0))
+        continue;
+      FrameContext frame(image_ptr->image);
+      RMChallengeVision::PILLAR_RESULT pillar_result;
+      int triangle_num= m_vision.detectPillar(frame, m_color, pillar_result);
+      float x, y, x1, y1;
+      bool line_found= m_vision.detectLineWithT(frame, x, y, x1, y1);
+      NODELET_INFO_STREAM_THROTTLE(
+          1.0, "triangles: " << triangle_num
+                             << " circle: " << pillar_result.circle_found
+                             << " arc: " << pillar_result.arc_found
+                             << " T: " << line_found << " dropped: "
+                             << m_mailbox.getDroppedCount());
+    }
+  }
+
+  RMChallengeVision m_vision;
+  RMChallengeVision::COLOR_TYPE m_color;
+  /*outlives the subscriber that posts to it*/
+  ImageMailbox m_mailbox;
+  std::unique_ptr<image_transport::ImageTransport> m_image_transport;
+  image_transport::Subscriber m_image_sub;
+  std::thread m_thread;
+  std::atomic<bool> m_running;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(rm_challenge::TestVisionNodelet, nodelet::Nodelet)
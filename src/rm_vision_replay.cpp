@@ -0,0 +1,172 @@
+#include "AprilTags/QRCode.h"
+#include "rm_challenge_latency_tracer.h"
+#include "rm_challenge_vision.h"
+
+#include <dirent.h>
+#include <chrono>
+#include <iomanip>
+
+/**
+ * Offline replay of recorded videos through the vision detectors, as
+ * fast as they run. Per detector fps and latency percentiles are printed
+ * at the end, the results of every frame are written one line per frame
+ * so two runs can be diffed.
+ *
+ * usage: rm_vision_replay <video file or directory> <r/b> <result file>
+ */
+
+/*height used to estimate the base position, same as the qrcode node*/
+#define REPLAY_BASE_HEIGHT 2.4
+
+struct DETECTOR_STAT
+{
+  double total_ms;
+  int frames;
+};
+
+static bool endsWith(const std::string& s, const std::string& suffix)
+{
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/**video files of path, sorted by name, or path itself if it is a file*/
+static std::vector<std::string> listVideos(const std::string& path)
+{
+  std::vector<std::string> files;
+  DIR* dir= opendir(path.c_str());
+  if(dir == NULL)
+  {
+    files.push_back(path);
+    return files;
+  }
+  struct dirent* entry;
+  while((entry= readdir(dir)) != NULL)
+  {
+    std::string name= entry->d_name;
+    if(endsWith(name, ".avi") || endsWith(name, ".mp4"))
+      files.push_back(path + "/" + name);
+  }
+  closedir(dir);
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+static double elapsedMs(const std::chrono::steady_clock::time_point& start)
+{
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "rm_vision_replay", ros::init_options::AnonymousName);
+  if(argc < 4 || (argv[2][0] != 'r' && argv[2][0] != 'b'))
+  {
+    std::cout << "usage: rm_vision_replay <video file or directory> <r/b> "
+                 "<result file>"
+              << std::endl;
+    return -1;
+  }
+  RMChallengeVision::COLOR_TYPE color=
+      argv[2][0] == 'r' ? RMChallengeVision::RED : RMChallengeVision::BLUE;
+  std::vector<std::string> files= listVideos(argv[1]);
+  std::ofstream result(argv[3]);
+  if(!result.is_open())
+  {
+    std::cout << "can't open " << argv[3] << std::endl;
+    return -2;
+  }
+  result << std::fixed << std::setprecision(3);
+
+  /*one instance per detector, as in the camera node*/
+  RMChallengeVision pillar_vision, line_vision;
+  pillar_vision.setVisability(false);
+  line_vision.setVisability(false);
+  QRCode qr_code;
+  qr_code.setVisability(false);
+  qr_code.setup();
+
+  FrameContext frame_context;
+  LatencyTracer latency(1 << 20);
+  const char* names[]= { "pillar", "line", "base", "frame" };
+  DETECTOR_STAT stats[4]= {};
+  cv::Mat frame;
+
+  for(int f= 0; f < (int)files.size(); f++)
+  {
+    cv::VideoCapture cap(files[f]);
+    if(!cap.isOpened())
+    {
+      std::cout << "can't open " << files[f] << std::endl;
+      continue;
+    }
+    std::cout << "replay " << files[f] << std::endl;
+    for(int n= 0; cap.read(frame) && !frame.empty(); n++)
+    {
+      /*the derived images are shared, the first detector that needs one
+       * pays for it, as on the uav*/
+      std::chrono::steady_clock::time_point frame_start=
+          std::chrono::steady_clock::now();
+      frame_context.reset(frame);
+      double ms[4];
+
+      std::chrono::steady_clock::time_point start=
+          std::chrono::steady_clock::now();
+      RMChallengeVision::PILLAR_RESULT pillar;
+      pillar_vision.detectPillar(frame_context, color, pillar);
+      ms[0]= elapsedMs(start);
+
+      start= std::chrono::steady_clock::now();
+      float distance_x, distance_y, line_vector_x, line_vector_y;
+      bool is_T_found= line_vision.detectLineWithT(
+          frame_context, distance_x, distance_y, line_vector_x, line_vector_y);
+      ms[1]= elapsedMs(start);
+
+      start= std::chrono::steady_clock::now();
+      bool base_found=
+          qr_code.getBasePosition(frame_context, REPLAY_BASE_HEIGHT);
+      ms[2]= elapsedMs(start);
+      ms[3]= elapsedMs(frame_start);
+
+      for(int i= 0; i < 4; i++)
+      {
+        latency.addSample(names[i], ms[i]);
+        stats[i].total_ms+= ms[i];
+        stats[i].frames++;
+      }
+
+      /*timing free, so runs can be diffed*/
+      result << files[f] << " " << n << " pillar " << pillar.triangle[0]
+             << " " << pillar.triangle[1] << " " << pillar.triangle[2] << " "
+             << pillar.triangle[3] << " " << pillar.circle_found << " "
+             << pillar.circle_center.x << " " << pillar.circle_center.y << " "
+             << pillar.radius << " " << pillar.arc_found << " "
+             << pillar.arc_center.x << " " << pillar.arc_center.y
+             << " line " << is_T_found << " " << distance_x << " "
+             << distance_y << " " << line_vector_x << " " << line_vector_y
+             << " base " << base_found << " " << qr_code.getBaseX() << " "
+             << qr_code.getBaseY() << "\n";
+    }
+  }
+  result.close();
+
+  test2::LatencyReport report;
+  latency.fillReport(report);
+  std::cout << std::fixed << std::setprecision(2);
+  for(int i= 0; i < (int)report.stage.size(); i++)
+  {
+    int k= 0;
+    while(k < 4 && report.stage[i] != names[k])
+      k++;
+    double fps= stats[k].total_ms > 0 ?
+                    stats[k].frames * 1000.0 / stats[k].total_ms :
+                    0;
+    std::cout << std::setw(8) << report.stage[i] << ": " << report.count[i]
+              << " frames, " << fps << " fps, p50 " << report.p50_ms[i]
+              << "ms p95 " << report.p95_ms[i] << "ms p99 " << report.p99_ms[i]
+              << "ms max " << report.max_ms[i] << "ms" << std::endl;
+  }
+  return 0;
+}